@@ -0,0 +1,291 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	uint16_t PackRgb565(const float r, const float g, const float b)
+	{
+		const uint32_t r5 = static_cast<uint32_t>(std::min(std::max(r, 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		const uint32_t g6 = static_cast<uint32_t>(std::min(std::max(g, 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		const uint32_t b5 = static_cast<uint32_t>(std::min(std::max(b, 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>(r5 << 11 | g6 << 5 | b5);
+	}
+
+	// Same expansion the hardware does, so texels are matched against the colours that will actually be decoded
+	void UnpackRgb565(const uint16_t color, int rgb[3])
+	{
+		const int r5 = color >> 11 & 31;
+		const int g6 = color >> 5 & 63;
+		const int b5 = color & 31;
+		rgb[0] = r5 << 3 | r5 >> 2;
+		rgb[1] = g6 << 2 | g6 >> 4;
+		rgb[2] = b5 << 3 | b5 >> 2;
+	}
+
+	void WriteU16(uint8_t* destination, const uint16_t value)
+	{
+		destination[0] = static_cast<uint8_t>(value);
+		destination[1] = static_cast<uint8_t>(value >> 8);
+	}
+}
+
+std::vector<Image> BlockCompressor::BuildMipChain(Image image)
+{
+	std::vector<Image> levels;
+	levels.push_back(std::move(image));
+
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		const Image& source = levels.back();
+
+		Image level;
+		level.width = std::max(source.width / 2, 1u);
+		level.height = std::max(source.height / 2, 1u);
+		level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+		// Average of the 2x2 texels under each new one, clamped at the edges of odd sized levels
+		for (uint32_t y = 0; y < level.height; ++y)
+		{
+			const uint32_t y0 = std::min(y * 2, source.height - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+
+			for (uint32_t x = 0; x < level.width; ++x)
+			{
+				const uint32_t x0 = std::min(x * 2, source.width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+
+				for (uint32_t channel = 0; channel < 4; ++channel)
+				{
+					const uint32_t sum = source.pixels[(static_cast<size_t>(y0) * source.width + x0) * 4 + channel] +
+						source.pixels[(static_cast<size_t>(y0) * source.width + x1) * 4 + channel] +
+						source.pixels[(static_cast<size_t>(y1) * source.width + x0) * 4 + channel] +
+						source.pixels[(static_cast<size_t>(y1) * source.width + x1) * 4 + channel];
+
+					level.pixels[(static_cast<size_t>(y) * level.width + x) * 4 + channel] =
+						static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		levels.push_back(std::move(level));
+	}
+
+	return levels;
+}
+
+bool BlockCompressor::HasAlpha(const Image& image)
+{
+	for (size_t i = 3; i < image.pixels.size(); i += 4)
+	{
+		if (image.pixels[i] != 255) return true;
+	}
+
+	return false;
+}
+
+std::vector<uint8_t> BlockCompressor::CompressBc1(const Image& image)
+{
+	const uint32_t blocksWide = (image.width + 3) / 4;
+	const uint32_t blocksHigh = (image.height + 3) / 4;
+
+	std::vector<uint8_t> blocks(static_cast<size_t>(blocksWide) * blocksHigh * 8);
+
+	uint8_t texels[16][4];
+	for (uint32_t y = 0; y < blocksHigh; ++y)
+	{
+		for (uint32_t x = 0; x < blocksWide; ++x)
+		{
+			ReadBlock(image, x, y, texels);
+			EncodeColorBlock(texels, &blocks[(static_cast<size_t>(y) * blocksWide + x) * 8]);
+		}
+	}
+
+	return blocks;
+}
+
+std::vector<uint8_t> BlockCompressor::CompressBc3(const Image& image)
+{
+	const uint32_t blocksWide = (image.width + 3) / 4;
+	const uint32_t blocksHigh = (image.height + 3) / 4;
+
+	std::vector<uint8_t> blocks(static_cast<size_t>(blocksWide) * blocksHigh * 16);
+
+	uint8_t texels[16][4];
+	for (uint32_t y = 0; y < blocksHigh; ++y)
+	{
+		for (uint32_t x = 0; x < blocksWide; ++x)
+		{
+			// Alpha block first, then a BC1 style colour block
+			uint8_t* block = &blocks[(static_cast<size_t>(y) * blocksWide + x) * 16];
+			ReadBlock(image, x, y, texels);
+			EncodeAlphaBlock(texels, block);
+			EncodeColorBlock(texels, block + 8);
+		}
+	}
+
+	return blocks;
+}
+
+void BlockCompressor::ReadBlock(const Image& image, const uint32_t blockX, const uint32_t blockY,
+                                uint8_t texels[16][4])
+{
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t x = std::min(blockX * 4 + i % 4, image.width - 1);
+		const uint32_t y = std::min(blockY * 4 + i / 4, image.height - 1);
+
+		const uint8_t* texel = &image.pixels[(static_cast<size_t>(y) * image.width + x) * 4];
+		std::copy(texel, texel + 4, texels[i]);
+	}
+}
+
+void BlockCompressor::EncodeColorBlock(const uint8_t texels[16][4], uint8_t* block)
+{
+	// Main axis of the colours, from a few power iterations on their covariance
+	float mean[3] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 3; ++c) mean[c] += texels[i][c] / 16.0f;
+	}
+
+	float covariance[3][3] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			for (uint32_t column = 0; column < 3; ++column) covariance[row][column] += d[row] * d[column];
+		}
+	}
+
+	float axis[3] = {1.0f, 1.0f, 1.0f};
+	for (uint32_t iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[3];
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+		}
+
+		const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f) break; // every texel is the same colour, any axis will do
+
+		for (uint32_t c = 0; c < 3; ++c) axis[c] = next[c] / length;
+	}
+
+	// Endpoints are the texels furthest along the axis in each direction
+	uint32_t minTexel = 0;
+	uint32_t maxTexel = 0;
+	float minProjection = 0.0f;
+	float maxProjection = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const float projection = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+		if (i == 0 || projection < minProjection)
+		{
+			minProjection = projection;
+			minTexel = i;
+		}
+		if (i == 0 || projection > maxProjection)
+		{
+			maxProjection = projection;
+			maxTexel = i;
+		}
+	}
+
+	uint16_t color0 = PackRgb565(texels[maxTexel][0], texels[maxTexel][1], texels[maxTexel][2]);
+	uint16_t color1 = PackRgb565(texels[minTexel][0], texels[minTexel][1], texels[minTexel][2]);
+
+	// color0 > color1 selects the four colour (opaque) mode
+	if (color0 < color1) std::swap(color0, color1);
+
+	WriteU16(block, color0);
+	WriteU16(block + 2, color1);
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		UnpackRgb565(color0, palette[0]);
+		UnpackRgb565(color1, palette[1]);
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint32_t bestIndex = 0;
+			int bestError = 0;
+			for (uint32_t p = 0; p < 4; ++p)
+			{
+				const int dr = texels[i][0] - palette[p][0];
+				const int dg = texels[i][1] - palette[p][1];
+				const int db = texels[i][2] - palette[p][2];
+				const int error = dr * dr + dg * dg + db * db;
+				if (p == 0 || error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+
+			indices |= bestIndex << (i * 2);
+		}
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		block[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
+
+void BlockCompressor::EncodeAlphaBlock(const uint8_t texels[16][4], uint8_t* block)
+{
+	uint8_t alpha0 = texels[0][3];
+	uint8_t alpha1 = texels[0][3];
+	for (uint32_t i = 1; i < 16; ++i)
+	{
+		alpha0 = std::max(alpha0, texels[i][3]);
+		alpha1 = std::min(alpha1, texels[i][3]);
+	}
+
+	// alpha0 > alpha1 selects the mode with six interpolated values between them
+	block[0] = alpha0;
+	block[1] = alpha1;
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		int palette[8] = {alpha0, alpha1};
+		for (int p = 1; p < 7; ++p)
+		{
+			palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+		}
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint64_t bestIndex = 0;
+			int bestError = 256;
+			for (uint32_t p = 0; p < 8; ++p)
+			{
+				const int error = std::abs(texels[i][3] - palette[p]);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+
+			indices |= bestIndex << (i * 3);
+		}
+	}
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		block[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
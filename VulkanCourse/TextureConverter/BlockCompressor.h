@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// RGBA8 image (4 bytes per texel), one level of a mip chain
+struct Image
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+// Encodes RGBA8 images into BC1 / BC3 blocks, 4x4 texels at a time.
+// Endpoints are fitted along each block's main colour axis, which is quick and close enough for diffuse textures.
+class BlockCompressor
+{
+public:
+	// Every level down to 1x1, each half the size of the one before (box filtered)
+	static std::vector<Image> BuildMipChain(Image image);
+
+	// Whether any texel isn't fully opaque, so the alpha needs its own block (BC3 over BC1)
+	static bool HasAlpha(const Image& image);
+
+	// Blocks of the whole image in row order, partial blocks at the edges repeat the last row / column
+	static std::vector<uint8_t> CompressBc1(const Image& image); // 8 bytes per block, opaque
+	static std::vector<uint8_t> CompressBc3(const Image& image); // 16 bytes per block
+
+private:
+	static void ReadBlock(const Image& image, uint32_t blockX, uint32_t blockY, uint8_t texels[16][4]);
+	static void EncodeColorBlock(const uint8_t texels[16][4], uint8_t* block);
+	static void EncodeAlphaBlock(const uint8_t texels[16][4], uint8_t* block);
+};
@@ -0,0 +1,271 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <vulkan/vulkan.h>
+
+#include "BlockCompressor.h"
+#include "stb_image.h"
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+	// Data format descriptor values (Khronos Data Format Specification) for the two formats written
+	const uint32_t KHR_DF_MODEL_BC1A = 128;
+	const uint32_t KHR_DF_MODEL_BC3 = 130;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+	const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+
+	enum class BlockFormat
+	{
+		Auto, // BC3 when the image has alpha, BC1 otherwise
+		Bc1,
+		Bc3
+	};
+
+	struct ConvertedLevel
+	{
+		std::vector<uint8_t> blocks;
+		uint64_t offset = 0;
+	};
+
+	void WriteU32(std::vector<uint8_t>& data, const uint32_t value)
+	{
+		for (uint32_t i = 0; i < 4; ++i) data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+	}
+
+	void WriteU64(std::vector<uint8_t>& data, const uint64_t value)
+	{
+		for (uint32_t i = 0; i < 8; ++i) data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+	}
+
+	uint64_t AlignUp(const uint64_t offset, const uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	bool HasExtension(const std::string& fileName, const char* extension)
+	{
+		const size_t length = strlen(extension);
+		if (fileName.size() < length) return false;
+
+		std::string ending = fileName.substr(fileName.size() - length);
+		std::transform(ending.begin(), ending.end(), ending.begin(), ::tolower);
+		return ending == extension;
+	}
+
+	// Source images in a directory (not recursive)
+	std::vector<std::string> FindImages(const std::string& directory)
+	{
+		std::vector<std::string> names;
+
+#ifdef _WIN32
+		WIN32_FIND_DATAA findData;
+		const HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &findData);
+		if (find == INVALID_HANDLE_VALUE) return names;
+		do
+		{
+			names.push_back(findData.cFileName);
+		}
+		while (FindNextFileA(find, &findData));
+		FindClose(find);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (!dir) return names;
+		while (const dirent* entry = readdir(dir))
+		{
+			names.push_back(entry->d_name);
+		}
+		closedir(dir);
+#endif
+
+		std::vector<std::string> images;
+		for (const auto& name : names)
+		{
+			if (HasExtension(name, ".png") || HasExtension(name, ".jpg") || HasExtension(name, ".jpeg"))
+			{
+				images.push_back(directory + "/" + name);
+			}
+		}
+		std::sort(images.begin(), images.end());
+
+		return images;
+	}
+
+	// KTX2 with a full mip chain, written next to the source with the same name (which is where the renderer looks)
+	void ConvertImage(const std::string& fileName, const BlockFormat requestedFormat)
+	{
+		int width;
+		int height;
+		int channels;
+		stbi_uc* pixels = stbi_load(fileName.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels)
+		{
+			throw std::runtime_error("Failed to load image! (" + fileName + ")");
+		}
+
+		Image image;
+		image.width = static_cast<uint32_t>(width);
+		image.height = static_cast<uint32_t>(height);
+		image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+		stbi_image_free(pixels);
+
+		const bool bc3 = requestedFormat == BlockFormat::Bc3 ||
+			(requestedFormat == BlockFormat::Auto && BlockCompressor::HasAlpha(image));
+		const VkFormat format = bc3 ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		const uint32_t blockBytes = bc3 ? 16 : 8;
+
+		const std::vector<Image> mipChain = BlockCompressor::BuildMipChain(std::move(image));
+
+		std::vector<ConvertedLevel> levels(mipChain.size());
+		for (size_t i = 0; i < mipChain.size(); ++i)
+		{
+			levels[i].blocks = bc3 ? BlockCompressor::CompressBc3(mipChain[i]) : BlockCompressor::CompressBc1(mipChain[i]);
+		}
+
+		// Data format descriptor: one basic block, with a sample per compressed channel
+		std::vector<uint8_t> descriptor;
+		const uint32_t sampleCount = bc3 ? 2 : 1;
+		WriteU32(descriptor, 0); // dfdTotalSize, filled in below
+		WriteU32(descriptor, 0); // vendorId, descriptorType (basic)
+		WriteU32(descriptor, 2 | (24 + 16 * sampleCount) << 16); // versionNumber, descriptorBlockSize
+		WriteU32(descriptor, (bc3 ? KHR_DF_MODEL_BC3 : KHR_DF_MODEL_BC1A) | KHR_DF_PRIMARIES_BT709 << 8 |
+		         KHR_DF_TRANSFER_LINEAR << 16);
+		WriteU32(descriptor, 3 | 3 << 8); // 4x4 texel blocks
+		WriteU32(descriptor, blockBytes); // bytesPlane0
+		WriteU32(descriptor, 0);
+		if (bc3)
+		{
+			WriteU32(descriptor, 0 | 63 << 16 | KHR_DF_CHANNEL_ALPHA << 24); // bits 0-63
+			WriteU32(descriptor, 0);
+			WriteU32(descriptor, 0);
+			WriteU32(descriptor, 0xFFFFFFFF);
+		}
+		WriteU32(descriptor, (bc3 ? 64 : 0) | 63 << 16 | KHR_DF_CHANNEL_COLOR << 24);
+		WriteU32(descriptor, 0);
+		WriteU32(descriptor, 0);
+		WriteU32(descriptor, 0xFFFFFFFF);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			descriptor[i] = static_cast<uint8_t>(descriptor.size() >> (i * 8));
+		}
+
+		// Level data goes smallest first, each level aligned to the block size
+		const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+		const uint64_t descriptorOffset = 80 + 24 * static_cast<uint64_t>(levelCount);
+		uint64_t offset = descriptorOffset + descriptor.size();
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			offset = AlignUp(offset, blockBytes);
+			levels[i].offset = offset;
+			offset += levels[i].blocks.size();
+		}
+
+		std::vector<uint8_t> header(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+		WriteU32(header, format);
+		WriteU32(header, 1); // typeSize
+		WriteU32(header, static_cast<uint32_t>(width));
+		WriteU32(header, static_cast<uint32_t>(height));
+		WriteU32(header, 0); // pixelDepth
+		WriteU32(header, 0); // layerCount
+		WriteU32(header, 1); // faceCount
+		WriteU32(header, levelCount);
+		WriteU32(header, 0); // supercompressionScheme
+		WriteU32(header, static_cast<uint32_t>(descriptorOffset));
+		WriteU32(header, static_cast<uint32_t>(descriptor.size()));
+		WriteU32(header, 0); // no key/value data
+		WriteU32(header, 0);
+		WriteU64(header, 0); // no supercompression global data
+		WriteU64(header, 0);
+		for (const auto& level : levels)
+		{
+			WriteU64(header, level.offset);
+			WriteU64(header, level.blocks.size());
+			WriteU64(header, level.blocks.size());
+		}
+
+		const std::string outputName = fileName.substr(0, fileName.rfind('.')) + ".ktx2";
+		std::ofstream output(outputName, std::ios::binary | std::ios::trunc);
+		if (!output.is_open())
+		{
+			throw std::runtime_error("Failed to open output file! (" + outputName + ")");
+		}
+
+		output.write(reinterpret_cast<const char*>(header.data()), header.size());
+		output.write(reinterpret_cast<const char*>(descriptor.data()), descriptor.size());
+
+		const char padding[16] = {};
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			output.write(padding, levels[i].offset - static_cast<uint64_t>(output.tellp()));
+			output.write(reinterpret_cast<const char*>(levels[i].blocks.data()), levels[i].blocks.size());
+		}
+
+		if (!output.good())
+		{
+			throw std::runtime_error("Failed to write output file! (" + outputName + ")");
+		}
+
+		std::cout << fileName << " -> " << outputName << " (" << (bc3 ? "BC3" : "BC1") << ", " << levelCount
+			<< " levels)\n";
+	}
+}
+
+// Usage: TextureConverter [--bc1 | --bc3] [--dir directory] [image...]
+// Converts the given images, or every PNG/JPG in the directory (Textures by default) when none are given
+int main(int argc, char* argv[])
+{
+	try
+	{
+		BlockFormat format = BlockFormat::Auto;
+		std::string directory = "Textures";
+		std::vector<std::string> images;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const bool hasValue = i + 1 < argc;
+
+			if (strcmp(argv[i], "--bc1") == 0) format = BlockFormat::Bc1;
+			else if (strcmp(argv[i], "--bc3") == 0) format = BlockFormat::Bc3;
+			else if (hasValue && strcmp(argv[i], "--dir") == 0) directory = argv[++i];
+			else if (argv[i][0] == '-') throw std::runtime_error(std::string("Unknown or incomplete argument: ") + argv[i]);
+			else images.push_back(argv[i]);
+		}
+
+		if (images.empty())
+		{
+			images = FindImages(directory);
+		}
+
+		for (const auto& image : images)
+		{
+			ConvertImage(image, format);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("\nERROR: %s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,535 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#include "VulkanRenderer.h"
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	double ElapsedMs(const Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Nearest-rank percentile of an already sorted list of samples
+	double Percentile(const std::vector<double>& sorted, const double percent)
+	{
+		if (sorted.empty()) return 0.0;
+
+		const size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+		return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+	}
+
+	void WriteSummary(std::ostream& stream, const char* name, const TimingSummary& summary, const bool last)
+	{
+		stream << "\t\"" << name << "\": {"
+			<< "\"mean\": " << summary.mean << ", "
+			<< "\"min\": " << summary.min << ", "
+			<< "\"max\": " << summary.max << ", "
+			<< "\"p50\": " << summary.p50 << ", "
+			<< "\"p95\": " << summary.p95 << ", "
+			<< "\"p99\": " << summary.p99 << "}"
+			<< (last ? "\n" : ",\n");
+	}
+
+	// Windows paths are full of backslashes, which JSON strings need escaped
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (const char c : text)
+		{
+			if (c == '\\' || c == '"') escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	// FrustumCuller::Cull against the one box at a time reference, for box counts that do and don't fill the
+	// last SIMD batch. Shrinking the same culler leaves stale boxes in the padding, which must never show up.
+	// Returns the first difference, empty when there is none
+	std::string CheckFrustumCuller()
+	{
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+		std::uniform_real_distribution<float> size(0.1f, 6.0f);
+		std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+		const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 50.0f);
+		const size_t boxCounts[] = {1000, 100003, 17, 16, 15, 9, 8, 7, 1, 0};
+
+		FrustumCuller culler;
+		std::vector<uint8_t> visible;
+		std::vector<uint8_t> expected;
+
+		for (const size_t boxCount : boxCounts)
+		{
+			culler.Resize(boxCount);
+			for (size_t i = 0; i < boxCount; ++i)
+			{
+				glm::mat4 transform = glm::translate(glm::mat4(1.0f), {position(random), position(random), position(random)});
+				transform = glm::rotate(transform, angle(random), glm::vec3(0, 1, 0));
+				transform = glm::rotate(transform, angle(random), glm::vec3(1, 0, 0));
+
+				culler.SetBox(i, -glm::vec3(size(random), size(random), size(random)),
+				              glm::vec3(size(random), size(random), size(random)), transform);
+			}
+
+			// A few views, so boxes cross every plane
+			for (int view = 0; view < 4; ++view)
+			{
+				const glm::vec3 direction(std::sin(angle(random)), std::sin(angle(random)) * 0.5f, std::cos(angle(random)));
+				const glm::mat4 viewProjection = projection *
+					glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0.0f, 1.0f, 0.0f));
+
+				const CullStats before = culler.GetStats();
+				culler.Cull(viewProjection, visible);
+				culler.CullReference(viewProjection, expected);
+				const CullStats after = culler.GetStats();
+
+				const size_t culledCount = static_cast<size_t>(std::count(expected.begin(), expected.end(), 0));
+				if (visible.size() != boxCount || after.tested - before.tested != boxCount ||
+					after.culled - before.culled != culledCount)
+				{
+					return std::to_string(boxCount) + " boxes: wrong result size or stats";
+				}
+
+				const auto difference = std::mismatch(visible.begin(), visible.end(), expected.begin());
+				if (difference.first != visible.end())
+				{
+					return std::to_string(boxCount) + " boxes: box " +
+						std::to_string(difference.first - visible.begin()) + " differs from the reference";
+				}
+			}
+		}
+
+		return std::string();
+	}
+
+	// DrawList::Sort against std::stable_sort on the keys. Draw indices tell equal keys apart, so the order of
+	// duplicates is checked too. Returns the first difference, empty when there is none
+	std::string CheckDrawListSort()
+	{
+		std::mt19937_64 random(3);
+		std::uniform_real_distribution<float> depth(-1.0f, 100.0f);
+
+		// How keys are made: fully random, like the renderer's (constant pipeline / texture bytes, so some
+		// passes are skipped), heavily duplicated, and all the same
+		const char* patterns[] = {"random", "renderer", "duplicates", "equal"};
+		const size_t itemCounts[] = {0, 1, 2, 255, 256, 257, 5000, 100000};
+
+		DrawList drawList;
+		std::vector<DrawItem> expected;
+
+		for (size_t pattern = 0; pattern < 4; ++pattern)
+		{
+			for (const size_t itemCount : itemCounts)
+			{
+				drawList.Clear();
+				for (size_t i = 0; i < itemCount; ++i)
+				{
+					uint64_t key;
+					switch (pattern)
+					{
+					case 0: key = random(); break;
+					case 1: key = DrawList::MakeKey(0, static_cast<uint32_t>(random() % 3),
+					                                static_cast<uint32_t>(random() % 40), depth(random)); break;
+					case 2: key = random() % 16 << 40 | random() % 4; break;
+					default: key = 0x0123456789ABCDEFull; break;
+					}
+					drawList.Add(key, 0, 0, static_cast<uint32_t>(i));
+				}
+
+				expected = drawList.GetItems();
+				std::stable_sort(expected.begin(), expected.end(), [](const DrawItem& a, const DrawItem& b)
+				{
+					return a.key < b.key;
+				});
+
+				drawList.Sort();
+				const std::vector<DrawItem>& items = drawList.GetItems();
+
+				if (items.size() != expected.size())
+				{
+					return std::string(patterns[pattern]) + " keys, " + std::to_string(itemCount) + " items: wrong size";
+				}
+				for (size_t i = 0; i < items.size(); ++i)
+				{
+					if (items[i].key != expected[i].key || items[i].drawIndex != expected[i].drawIndex)
+					{
+						return std::string(patterns[pattern]) + " keys, " + std::to_string(itemCount) + " items: item " +
+							std::to_string(i) + " differs from std::stable_sort";
+					}
+				}
+			}
+		}
+
+		return std::string();
+	}
+
+	void WriteCheck(std::ostream& stream, const char* name, const std::string& error, const bool last)
+	{
+		stream << "\t\t\"" << name << "\": {"
+			<< "\"passed\": " << (error.empty() ? "true" : "false") << ", "
+			<< "\"error\": \"" << EscapeJson(error) << "\"}"
+			<< (last ? "\n" : ",\n");
+	}
+}
+
+FrameBenchmark::FrameBenchmark(BenchmarkSettings newSettings)
+	: settings(std::move(newSettings))
+{
+}
+
+BenchmarkResults FrameBenchmark::Run(VulkanRenderer& renderer) const
+{
+	BenchmarkResults results;
+	results.cpuFrameMs.reserve(settings.frames);
+	results.fenceWaitMs.reserve(settings.frames);
+
+	const auto loadStart = Clock::now();
+	uint32_t modelIndex;
+	if (settings.stream)
+	{
+		// Keep drawing while the model streams in, the frame times show how much loading disturbs them
+		modelIndex = renderer.LoadMeshModelAsync(settings.modelFile);
+		while (renderer.GetModelLoadState(modelIndex) == ModelLoadState::LOADING &&
+			results.streamFrameMs.size() < settings.maxStreamFrames)
+		{
+			const auto frameStart = Clock::now();
+			renderer.Draw();
+			results.streamFrameMs.push_back(ElapsedMs(frameStart));
+		}
+
+		if (renderer.GetModelLoadState(modelIndex) == ModelLoadState::LOADING)
+		{
+			throw std::runtime_error("Failed to stream model, still loading after " +
+				std::to_string(settings.maxStreamFrames) + " frames");
+		}
+		if (!renderer.IsModelLoaded(modelIndex))
+		{
+			throw std::runtime_error("Failed to stream model: " + renderer.GetModelLoadError(modelIndex));
+		}
+	}
+	else
+	{
+		modelIndex = renderer.CreateMeshModel(settings.modelFile);
+		renderer.WaitForUploads(); // uploads are only submitted with the next frame otherwise
+	}
+	results.modelLoadMs = ElapsedMs(loadStart);
+
+	// Square grid in the model's local space, spaced wide enough for the default model
+	const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(settings.instances))));
+	for (uint32_t i = 0; i < settings.instances; ++i)
+	{
+		const float x = (static_cast<float>(i % gridSize) - gridSize * 0.5f) * 10.0f;
+		const float z = (static_cast<float>(i / gridSize) - gridSize * 0.5f) * 10.0f;
+		renderer.AddModelInstance(modelIndex, glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z)));
+	}
+
+	// The renderer counts every frame it submits, the ones drawn while streaming included
+	const uint64_t firstMeasuredFrame = results.streamFrameMs.size() + settings.warmupFrames;
+
+	float angle = 0.0f;
+	CullStats warmupCullStats;
+	uint64_t lastGpuFrame = 0;
+	bool hasGpuFrame = false;
+
+	for (uint32_t frame = 0; frame < settings.warmupFrames + settings.frames; ++frame)
+	{
+		const auto frameStart = Clock::now();
+
+		// Same animation as Window::LoopWindow, but driven by a fixed step instead of the wall clock
+		angle += 1.0f * settings.timeStep;
+		if (angle > 360.0f)
+		{
+			angle -= 360.0f;
+		}
+
+		glm::mat4 testMat = glm::mat4(1.0f);
+		testMat = glm::rotate(testMat, 45.0f, {0, 0, 1});
+		testMat = glm::translate(testMat, glm::vec3(0, -2, -1));
+		testMat = glm::scale(testMat, {0.25f, 0.25f, 0.25f});
+		testMat = glm::rotate(testMat, angle, glm::vec3(0, 1, 0));
+		renderer.UpdateModel(modelIndex, testMat);
+
+		renderer.Draw();
+
+		if (frame < settings.warmupFrames)
+		{
+			warmupCullStats = renderer.GetCullStats();
+			continue;
+		}
+
+		results.cpuFrameMs.push_back(ElapsedMs(frameStart));
+		results.fenceWaitMs.push_back(renderer.GetLastFenceWaitMs());
+
+		// Only record GPU results of the measured frames, same as the CPU ones (renderer is expected to be fresh),
+		// and each one only once
+		const GpuTimings gpuTimings = renderer.GetGpuTimings();
+		if (gpuTimings.valid && gpuTimings.frameNumber >= firstMeasuredFrame &&
+			(!hasGpuFrame || gpuTimings.frameNumber > lastGpuFrame))
+		{
+			hasGpuFrame = true;
+			lastGpuFrame = gpuTimings.frameNumber;
+			results.gpuCullMs.push_back(gpuTimings.cullMs);
+			results.gpuGeometryMs.push_back(gpuTimings.geometryMs);
+			results.gpuCompositeMs.push_back(gpuTimings.compositeMs);
+			results.gpuCommandBufferMs.push_back(gpuTimings.commandBufferMs);
+		}
+	}
+
+	const CullStats cullStats = renderer.GetCullStats();
+	results.cullTested = cullStats.tested - warmupCullStats.tested;
+	results.cullCulled = cullStats.culled - warmupCullStats.culled;
+
+	return results;
+}
+
+void FrameBenchmark::WriteJson(std::ostream& stream, const VulkanRenderer& renderer,
+                               const BenchmarkResults& results) const
+{
+	const VkExtent2D extent = renderer.GetExtent();
+	const MemoryStats memoryStats = renderer.GetMemoryStats();
+	const BindStats bindStats = renderer.GetBindStats();
+
+	stream << "{\n"
+		<< "\t\"model\": \"" << EscapeJson(settings.modelFile) << "\",\n"
+		<< "\t\"headless\": " << (renderer.IsHeadless() ? "true" : "false") << ",\n"
+		<< "\t\"width\": " << extent.width << ",\n"
+		<< "\t\"height\": " << extent.height << ",\n"
+		<< "\t\"warmupFrames\": " << settings.warmupFrames << ",\n"
+		<< "\t\"frames\": " << results.cpuFrameMs.size() << ",\n"
+		<< "\t\"timeStep\": " << settings.timeStep << ",\n"
+		<< "\t\"instances\": " << settings.instances << ",\n"
+		<< "\t\"modelLoadMs\": " << results.modelLoadMs << ",\n"
+		<< "\t\"stream\": " << (settings.stream ? "true" : "false") << ",\n"
+		<< "\t\"streamFrames\": " << results.streamFrameMs.size() << ",\n"
+		<< "\t\"vertexBytes\": " << sizeof(DeviceVertex) << ",\n"
+		<< "\t\"dedicatedTransferQueue\": " << (renderer.IsTransferQueueDedicated() ? "true" : "false") << ",\n"
+		<< "\t\"gpuSamples\": " << results.gpuCommandBufferMs.size() << ",\n"
+		<< "\t\"memory\": {"
+		<< "\"blocks\": " << memoryStats.blockCount << ", "
+		<< "\"dedicatedBlocks\": " << memoryStats.dedicatedBlockCount << ", "
+		<< "\"allocations\": " << memoryStats.allocationCount << ", "
+		<< "\"blockBytes\": " << memoryStats.blockBytes << ", "
+		<< "\"usedBytes\": " << memoryStats.usedBytes << "},\n"
+		<< "\t\"binds\": {"
+		<< "\"pipeline\": " << bindStats.pipelineBinds << ", "
+		<< "\"descriptorSet\": " << bindStats.descriptorSetBinds << ", "
+		<< "\"buffer\": " << bindStats.bufferBinds << ", "
+		<< "\"texture\": " << bindStats.textureChanges << ", "
+		<< "\"draws\": " << bindStats.draws << "},\n"
+		<< "\t\"cpuCull\": {"
+		<< "\"tested\": " << results.cullTested << ", "
+		<< "\"culled\": " << results.cullCulled << "},\n";
+
+	WriteSummary(stream, "streamFrameMs", Summarize(results.streamFrameMs), false);
+	WriteSummary(stream, "cpuFrameMs", Summarize(results.cpuFrameMs), false);
+	WriteSummary(stream, "fenceWaitMs", Summarize(results.fenceWaitMs), false);
+	WriteSummary(stream, "gpuCullMs", Summarize(results.gpuCullMs), false);
+	WriteSummary(stream, "gpuGeometryMs", Summarize(results.gpuGeometryMs), false);
+	WriteSummary(stream, "gpuCompositeMs", Summarize(results.gpuCompositeMs), false);
+	WriteSummary(stream, "gpuCommandBufferMs", Summarize(results.gpuCommandBufferMs), true);
+
+	stream << "}\n";
+}
+
+TimingSummary FrameBenchmark::Summarize(std::vector<double> samples)
+{
+	TimingSummary summary;
+	if (samples.empty()) return summary;
+
+	std::sort(samples.begin(), samples.end());
+
+	summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	summary.min = samples.front();
+	summary.max = samples.back();
+	summary.p50 = Percentile(samples, 50.0);
+	summary.p95 = Percentile(samples, 95.0);
+	summary.p99 = Percentile(samples, 99.0);
+
+	return summary;
+}
+
+CullBenchmark::CullBenchmark(CullBenchmarkSettings newSettings)
+	: settings(std::move(newSettings))
+{
+}
+
+void CullBenchmark::Run(std::ostream& stream) const
+{
+	// Fixed seed, so every run culls the same scene
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> size(0.5f, 4.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+	FrustumCuller culler;
+	culler.Resize(settings.boxCount);
+
+	for (uint32_t i = 0; i < settings.boxCount; ++i)
+	{
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), {position(random), position(random), position(random)});
+		transform = glm::rotate(transform, angle(random), glm::vec3(0, 1, 0));
+
+		const glm::vec3 halfSize(size(random));
+		culler.SetBox(i, -halfSize, halfSize, transform);
+	}
+
+	// Same projection as the renderer, looking along one axis from the middle of the boxes
+	const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 viewProjection = projection * view;
+
+	std::vector<uint8_t> visible;
+	std::vector<double> cullMs;
+	cullMs.reserve(settings.iterations);
+
+	for (uint32_t i = 0; i < settings.iterations; ++i)
+	{
+		const auto cullStart = Clock::now();
+		culler.Cull(viewProjection, visible);
+		cullMs.push_back(ElapsedMs(cullStart));
+	}
+
+	const CullStats stats = culler.GetStats();
+	const TimingSummary summary = FrameBenchmark::Summarize(cullMs);
+
+	stream << "{\n"
+		<< "\t\"kernel\": \"" << FrustumCuller::GetKernelName() << "\",\n"
+		<< "\t\"boxes\": " << settings.boxCount << ",\n"
+		<< "\t\"iterations\": " << settings.iterations << ",\n"
+		<< "\t\"tested\": " << stats.tested << ",\n"
+		<< "\t\"culled\": " << stats.culled << ",\n"
+		<< "\t\"nsPerBox\": " << (settings.boxCount > 0 ? summary.mean * 1.0e6 / settings.boxCount : 0.0) << ",\n";
+
+	WriteSummary(stream, "cullMs", summary, true);
+
+	stream << "}\n";
+}
+
+bool SelfTest::Run(std::ostream& stream) const
+{
+	const std::string cullError = CheckFrustumCuller();
+	const std::string sortError = CheckDrawListSort();
+	const bool passed = cullError.empty() && sortError.empty();
+
+	stream << "{\n"
+		<< "\t\"kernel\": \"" << FrustumCuller::GetKernelName() << "\",\n"
+		<< "\t\"checks\": {\n";
+
+	WriteCheck(stream, "frustumCuller", cullError, false);
+	WriteCheck(stream, "drawListSort", sortError, true);
+
+	stream << "\t},\n"
+		<< "\t\"passed\": " << (passed ? "true" : "false") << "\n"
+		<< "}\n";
+
+	return passed;
+}
+
+StreamCheck::StreamCheck(StreamCheckSettings newSettings)
+	: settings(std::move(newSettings))
+{
+}
+
+bool StreamCheck::Run(VulkanRenderer& renderer, std::ostream& stream) const
+{
+	std::vector<uint32_t> loadFrames;
+	std::string error;
+	bool passed = true;
+
+	for (uint32_t load = 0; load < settings.loads && passed; ++load)
+	{
+		const uint32_t modelIndex = renderer.LoadMeshModelAsync(settings.modelFile);
+
+		uint32_t frames = 0;
+		while (renderer.GetModelLoadState(modelIndex) == ModelLoadState::LOADING && frames < settings.maxFrames)
+		{
+			renderer.Draw();
+			++frames;
+		}
+
+		loadFrames.push_back(frames);
+		passed = renderer.IsModelLoaded(modelIndex);
+		if (renderer.GetModelLoadState(modelIndex) == ModelLoadState::FAILED)
+		{
+			error = renderer.GetModelLoadError(modelIndex);
+		}
+	}
+
+	stream << "{\n"
+		<< "\t\"model\": \"" << EscapeJson(settings.modelFile) << "\",\n"
+		<< "\t\"maxFrames\": " << settings.maxFrames << ",\n"
+		<< "\t\"loadFrames\": [";
+	for (size_t i = 0; i < loadFrames.size(); ++i)
+	{
+		stream << (i > 0 ? ", " : "") << loadFrames[i];
+	}
+	stream << "],\n"
+		<< "\t\"error\": \"" << EscapeJson(error) << "\",\n"
+		<< "\t\"passed\": " << (passed ? "true" : "false") << "\n"
+		<< "}\n";
+
+	return passed;
+}
+
+GpuCullCheck::GpuCullCheck(GpuCullCheckSettings newSettings)
+	: settings(std::move(newSettings))
+{
+}
+
+bool GpuCullCheck::Run(VulkanRenderer& renderer, std::ostream& stream) const
+{
+	std::vector<uint32_t> modelIndices;
+	for (uint32_t i = 0; i < settings.copies; ++i)
+	{
+		modelIndices.push_back(renderer.CreateMeshModel(settings.modelFile));
+	}
+	renderer.WaitForUploads();
+
+	std::string error;
+	uint32_t checkedFrames = 0;
+	bool passed = true;
+
+	for (uint32_t frame = 0; frame < settings.frames && passed; ++frame)
+	{
+		// The row slides one spacing to the side over the run, wide enough that most copies are out of view
+		const float spacing = 5.0f;
+		const float slide = spacing * static_cast<float>(frame) / static_cast<float>(settings.frames);
+		for (uint32_t i = 0; i < modelIndices.size(); ++i)
+		{
+			const float x = (static_cast<float>(i) - static_cast<float>(modelIndices.size()) * 0.5f) * spacing + slide;
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, -2.0f, -5.0f));
+			transform = glm::scale(transform, {0.25f, 0.25f, 0.25f});
+			transform = glm::rotate(transform, static_cast<float>(frame) * 0.05f, glm::vec3(0, 1, 0));
+			renderer.UpdateModel(modelIndices[i], transform);
+		}
+
+		renderer.Draw();
+
+		passed = renderer.CheckGpuCulling(&error);
+		if (passed) ++checkedFrames;
+		else error = "Frame " + std::to_string(frame) + ": " + error;
+	}
+
+	stream << "{\n"
+		<< "\t\"model\": \"" << EscapeJson(settings.modelFile) << "\",\n"
+		<< "\t\"copies\": " << settings.copies << ",\n"
+		<< "\t\"frames\": " << settings.frames << ",\n"
+		<< "\t\"checkedFrames\": " << checkedFrames << ",\n"
+		<< "\t\"error\": \"" << EscapeJson(error) << "\",\n"
+		<< "\t\"passed\": " << (passed ? "true" : "false") << "\n"
+		<< "}\n";
+
+	return passed;
+}
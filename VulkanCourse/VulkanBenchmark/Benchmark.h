@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class VulkanRenderer;
+
+struct BenchmarkSettings
+{
+	std::string modelFile = "Models/nanosuit.obj"; // scene loaded once before timing starts
+	uint32_t warmupFrames = 60; // frames drawn but not recorded (pipeline caches, driver warm up)
+	uint32_t frames = 1000; // frames recorded
+	float timeStep = 1.0f / 60.0f; // fixed simulation step, so every run animates identically
+	uint32_t instances = 0; // when set, the model is drawn this many times as instances laid out in a grid
+	bool stream = false; // load the model in the background while frames are drawn, instead of up front
+	uint32_t maxStreamFrames = 1000; // frames streaming may take before the run fails as stuck
+};
+
+// Summary of a set of timing samples (all values in milliseconds)
+struct TimingSummary
+{
+	double mean = 0.0;
+	double min = 0.0;
+	double max = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+};
+
+struct BenchmarkResults
+{
+	double modelLoadMs = 0.0;
+	std::vector<double> streamFrameMs; // frames drawn while the model was streaming in (only with stream set)
+	std::vector<double> cpuFrameMs; // time spent in UpdateModel + Draw per frame
+	std::vector<double> fenceWaitMs; // part of the cpu frame time spent waiting on the frame fence
+	std::vector<double> gpuCullMs; // GPU timings arrive a frame or two late, so these can have fewer samples
+	std::vector<double> gpuGeometryMs;
+	std::vector<double> gpuCompositeMs;
+	std::vector<double> gpuCommandBufferMs;
+	uint64_t cullTested = 0; // CPU culling work over the recorded frames (zero when it is off)
+	uint64_t cullCulled = 0;
+};
+
+class FrameBenchmark
+{
+public:
+	explicit FrameBenchmark(BenchmarkSettings newSettings);
+
+	BenchmarkResults Run(VulkanRenderer& renderer) const;
+	void WriteJson(std::ostream& stream, const VulkanRenderer& renderer, const BenchmarkResults& results) const;
+
+	static TimingSummary Summarize(std::vector<double> samples);
+
+private:
+	BenchmarkSettings settings;
+};
+
+struct CullBenchmarkSettings
+{
+	uint32_t boxCount = 100000; // random boxes scattered around the camera
+	uint32_t iterations = 200; // times every box is culled
+};
+
+// Times FrustumCuller on its own, without a renderer or device
+class CullBenchmark
+{
+public:
+	explicit CullBenchmark(CullBenchmarkSettings newSettings);
+
+	void Run(std::ostream& stream) const;
+
+private:
+	CullBenchmarkSettings settings;
+};
+
+// Checks the CPU kernels (frustum culling, draw sorting) against plain reference versions of them, without a renderer or device
+class SelfTest
+{
+public:
+	bool Run(std::ostream& stream) const; // false when any check failed
+};
+
+struct StreamCheckSettings
+{
+	std::string modelFile = "Models/nanosuit.obj";
+	uint32_t loads = 3; // copies streamed in one after another, all but the first find their textures cached
+	uint32_t maxFrames = 1000; // frames a load may take before it counts as stuck
+};
+
+// Streams the same model in again and again while the earlier copies stay loaded, so later loads share their
+// textures (and, once it has been written, use the cooked mesh file). Fails when a load never finishes.
+class StreamCheck
+{
+public:
+	explicit StreamCheck(StreamCheckSettings newSettings);
+
+	bool Run(VulkanRenderer& renderer, std::ostream& stream) const; // false when a load got stuck
+
+private:
+	StreamCheckSettings settings;
+};
+
+struct GpuCullCheckSettings
+{
+	std::string modelFile = "Models/nanosuit.obj";
+	uint32_t copies = 9; // models in a row, sliding across the view so they leave and enter the frustum
+	uint32_t frames = 240;
+};
+
+// Draws with GPU culling and, after every frame, checks the indirect commands the cull pass wrote against
+// CPU culling of the same boxes. Fails at the first frame where they differ.
+class GpuCullCheck
+{
+public:
+	explicit GpuCullCheck(GpuCullCheckSettings newSettings);
+
+	bool Run(VulkanRenderer& renderer, std::ostream& stream) const; // false when a frame didn't match
+
+private:
+	GpuCullCheckSettings settings;
+};
@@ -0,0 +1,199 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "Benchmark.h"
+#include "VulkanRenderer.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Usage: VulkanBenchmark [--model file] [--frames n] [--warmup n] [--step seconds]
+//                        [--width n] [--height n] [--images n] [--gpu-log n] [--cache-commands]
+//                        [--record-threads n] [--indirect] [--gpu-cull]
+//                        [--cpu-cull] [--instances n] [--sort-draws] [--stream] [--max-stream-frames n] [--output file.json]
+//        VulkanBenchmark --cull-bench boxes [--iterations n] [--output file.json]
+//        VulkanBenchmark --self-test [--output file.json]
+//        VulkanBenchmark --stream-check loads [--model file] [--output file.json]
+//        VulkanBenchmark --gpu-cull-check frames [--model file] [--output file.json]
+int main(int argc, char* argv[])
+{
+	try
+	{
+		BenchmarkSettings benchmarkSettings;
+		HeadlessSettings headlessSettings;
+		std::string outputFile;
+		uint32_t gpuLogInterval = 0;
+		bool cacheCommandBuffers = false;
+		uint32_t recordingThreads = 0;
+		bool indirectDrawing = false;
+		bool gpuCulling = false;
+		bool cpuCulling = false;
+		bool sortDraws = false;
+		CullBenchmarkSettings cullBenchmarkSettings;
+		bool cullBenchmark = false;
+		bool selfTest = false;
+		StreamCheckSettings streamCheckSettings;
+		bool streamCheck = false;
+		GpuCullCheckSettings gpuCullCheckSettings;
+		bool gpuCullCheck = false;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const bool hasValue = i + 1 < argc;
+
+			if (hasValue && strcmp(argv[i], "--model") == 0) benchmarkSettings.modelFile = argv[++i];
+			else if (hasValue && strcmp(argv[i], "--frames") == 0) benchmarkSettings.frames = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--warmup") == 0) benchmarkSettings.warmupFrames = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--instances") == 0) benchmarkSettings.instances = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--step") == 0) benchmarkSettings.timeStep = std::stof(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--width") == 0) headlessSettings.extent.width = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--height") == 0) headlessSettings.extent.height = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--images") == 0) headlessSettings.frameCount = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--gpu-log") == 0) gpuLogInterval = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--record-threads") == 0) recordingThreads = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--output") == 0) outputFile = argv[++i];
+			else if (strcmp(argv[i], "--cache-commands") == 0) cacheCommandBuffers = true;
+			else if (strcmp(argv[i], "--indirect") == 0) indirectDrawing = true;
+			else if (strcmp(argv[i], "--gpu-cull") == 0) gpuCulling = true;
+			else if (strcmp(argv[i], "--cpu-cull") == 0) cpuCulling = true;
+			else if (strcmp(argv[i], "--sort-draws") == 0) sortDraws = true;
+			else if (strcmp(argv[i], "--stream") == 0) benchmarkSettings.stream = true;
+			else if (strcmp(argv[i], "--self-test") == 0) selfTest = true;
+			else if (hasValue && strcmp(argv[i], "--max-stream-frames") == 0) benchmarkSettings.maxStreamFrames = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--cull-bench") == 0)
+			{
+				cullBenchmark = true;
+				cullBenchmarkSettings.boxCount = std::stoul(argv[++i]);
+			}
+			else if (hasValue && strcmp(argv[i], "--iterations") == 0) cullBenchmarkSettings.iterations = std::stoul(argv[++i]);
+			else if (hasValue && strcmp(argv[i], "--stream-check") == 0)
+			{
+				streamCheck = true;
+				streamCheckSettings.loads = std::stoul(argv[++i]);
+			}
+			else if (hasValue && strcmp(argv[i], "--gpu-cull-check") == 0)
+			{
+				gpuCullCheck = true;
+				gpuCullCheckSettings.frames = std::stoul(argv[++i]);
+			}
+			else throw std::runtime_error(std::string("Unknown or incomplete argument: ") + argv[i]);
+		}
+
+		// Culling micro benchmark doesn't need a device at all
+		if (cullBenchmark)
+		{
+			const CullBenchmark benchmark(cullBenchmarkSettings);
+			if (outputFile.empty())
+			{
+				benchmark.Run(std::cout);
+			}
+			else
+			{
+				std::ofstream file(outputFile);
+				if (!file.is_open())
+					throw std::runtime_error("Failed to open benchmark output file: " + outputFile);
+
+				benchmark.Run(file);
+			}
+			return EXIT_SUCCESS;
+		}
+
+		// Self test only checks CPU code, so it doesn't need a device either
+		if (selfTest)
+		{
+			const SelfTest test;
+
+			bool passed;
+			if (outputFile.empty())
+			{
+				passed = test.Run(std::cout);
+			}
+			else
+			{
+				std::ofstream file(outputFile);
+				if (!file.is_open())
+					throw std::runtime_error("Failed to open benchmark output file: " + outputFile);
+
+				passed = test.Run(file);
+			}
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Benchmark nodes have no display, so always render offscreen
+		VulkanRenderer renderer(headlessSettings);
+		renderer.SetGpuProfilerLogInterval(gpuLogInterval);
+		renderer.SetCommandBufferCaching(cacheCommandBuffers);
+		renderer.SetRecordingThreadCount(recordingThreads);
+		renderer.SetIndirectDrawing(indirectDrawing || gpuCulling || gpuCullCheck); // culling builds the indirect commands
+		renderer.SetGpuCulling(gpuCulling || gpuCullCheck);
+		renderer.SetCpuCulling(cpuCulling);
+		renderer.SetDrawSorting(sortDraws);
+
+		// Streaming check fails the run when a load never finishes, instead of timing anything
+		if (streamCheck)
+		{
+			streamCheckSettings.modelFile = benchmarkSettings.modelFile;
+			const StreamCheck check(streamCheckSettings);
+
+			bool passed;
+			if (outputFile.empty())
+			{
+				passed = check.Run(renderer, std::cout);
+			}
+			else
+			{
+				std::ofstream file(outputFile);
+				if (!file.is_open())
+					throw std::runtime_error("Failed to open benchmark output file: " + outputFile);
+
+				passed = check.Run(renderer, file);
+			}
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// GPU culling check compares the cull pass with CPU culling every frame, instead of timing anything
+		if (gpuCullCheck)
+		{
+			gpuCullCheckSettings.modelFile = benchmarkSettings.modelFile;
+			const GpuCullCheck check(gpuCullCheckSettings);
+
+			bool passed;
+			if (outputFile.empty())
+			{
+				passed = check.Run(renderer, std::cout);
+			}
+			else
+			{
+				std::ofstream file(outputFile);
+				if (!file.is_open())
+					throw std::runtime_error("Failed to open benchmark output file: " + outputFile);
+
+				passed = check.Run(renderer, file);
+			}
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		const FrameBenchmark benchmark(benchmarkSettings);
+		const BenchmarkResults results = benchmark.Run(renderer);
+
+		if (outputFile.empty())
+		{
+			benchmark.WriteJson(std::cout, renderer, results);
+		}
+		else
+		{
+			std::ofstream file(outputFile);
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open benchmark output file: " + outputFile);
+
+			benchmark.WriteJson(file, renderer, results);
+		}
+	}
+	catch (std::exception& e)
+	{
+		printf("\nERROR: %s\n", e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+#include "DeviceMemoryAllocator.h"
+
+#include <algorithm>
+#include "Utilities.h"
+
+namespace
+{
+	VkDeviceSize NextPowerOfTwo(const VkDeviceSize size)
+	{
+		VkDeviceSize power = 1;
+		while (power < size)
+		{
+			power <<= 1;
+		}
+		return power;
+	}
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
+                                             const VkDeviceSize newBlockSize)
+	: physicalDevice(newPhysicalDevice), device(newDevice), blockSize(NextPowerOfTwo(newBlockSize)),
+	  minAllocationSize(0), orderCount(0)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	// Buddy ranges are aligned to their own size, so a range never shares a page with its neighbours
+	minAllocationSize = NextPowerOfTwo(std::max<VkDeviceSize>(256, deviceProperties.limits.bufferImageGranularity));
+	minAllocationSize = std::min(minAllocationSize, blockSize);
+
+	while ((minAllocationSize << orderCount) <= blockSize)
+	{
+		++orderCount;
+	}
+
+	blocks.resize(memoryProperties.memoryTypeCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		memoryTypeFlags.push_back(memoryProperties.memoryTypes[i].propertyFlags);
+	}
+}
+
+MemoryAllocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                                 const VkMemoryPropertyFlags properties)
+{
+	const uint32_t memoryTypeIndex = FindMemoryTypeIndex(physicalDevice, requirements.memoryTypeBits, properties);
+
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	MemoryAllocation allocation;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+
+	auto& typeBlocks = blocks[memoryTypeIndex];
+	const uint32_t order = GetOrder(std::max(requirements.size, requirements.alignment));
+
+	if (order >= orderCount)
+	{
+		// Too big for a block, give it device memory of its own
+		allocation.blockIndex = CreateBlock(memoryTypeIndex, requirements.size, true);
+		allocation.size = requirements.size;
+	}
+	else
+	{
+		allocation.size = minAllocationSize << order;
+
+		bool found = false;
+		for (uint32_t i = 0; i < typeBlocks.size() && !found; ++i)
+		{
+			if (typeBlocks[i].memory == VK_NULL_HANDLE || typeBlocks[i].dedicated) continue;
+
+			if (AllocateFromBlock(typeBlocks[i], order, &allocation.offset))
+			{
+				allocation.blockIndex = i;
+				found = true;
+			}
+		}
+
+		// Every block of this type is full, so start a new one
+		if (!found)
+		{
+			allocation.blockIndex = CreateBlock(memoryTypeIndex, blockSize, false);
+			AllocateFromBlock(typeBlocks[allocation.blockIndex], order, &allocation.offset);
+		}
+	}
+
+	MemoryBlock& block = typeBlocks[allocation.blockIndex];
+	++block.allocationCount;
+
+	allocation.memory = block.memory;
+	if (block.mappedData != nullptr)
+	{
+		allocation.mappedData = block.mappedData + allocation.offset;
+	}
+
+	++stats.allocationCount;
+	stats.usedBytes += allocation.size;
+
+	return allocation;
+}
+
+void DeviceMemoryAllocator::Free(const MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	MemoryBlock& block = blocks[allocation.memoryTypeIndex][allocation.blockIndex];
+	--block.allocationCount;
+
+	--stats.allocationCount;
+	stats.usedBytes -= allocation.size;
+
+	if (block.dedicated)
+	{
+		DestroyBlock(block);
+		return;
+	}
+
+	// Merge with the buddy range for as long as it is free too
+	VkDeviceSize offset = allocation.offset;
+	uint32_t order = GetOrder(allocation.size);
+
+	while (order + 1 < orderCount)
+	{
+		const VkDeviceSize buddy = offset ^ (minAllocationSize << order);
+		if (block.freeRanges[order].erase(buddy) == 0) break;
+
+		offset = std::min(offset, buddy);
+		++order;
+	}
+
+	block.freeRanges[order].insert(offset);
+
+	// An emptied block goes back to the device, unless it's the only empty one of its type. That one is kept
+	// as a spare, so a scene that frees and reloads assets doesn't allocate a new block every time
+	if (block.allocationCount > 0) return;
+
+	for (const auto& otherBlock : blocks[allocation.memoryTypeIndex])
+	{
+		if (&otherBlock != &block && otherBlock.memory != VK_NULL_HANDLE && !otherBlock.dedicated &&
+			otherBlock.allocationCount == 0)
+		{
+			DestroyBlock(block);
+			return;
+		}
+	}
+}
+
+MemoryStats DeviceMemoryAllocator::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+	return stats;
+}
+
+void DeviceMemoryAllocator::DestroyAllocator()
+{
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	for (auto& typeBlocks : blocks)
+	{
+		for (auto& block : typeBlocks)
+		{
+			DestroyBlock(block);
+		}
+	}
+
+	blocks.clear();
+}
+
+uint32_t DeviceMemoryAllocator::CreateBlock(const uint32_t memoryTypeIndex, const VkDeviceSize size,
+                                            const bool dedicated)
+{
+	MemoryBlock block;
+	block.size = size;
+	block.dedicated = dedicated;
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.allocationSize = size;
+	memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VK_ERROR(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &block.memory),
+	         "Failed to allocate device memory block");
+
+	if (memoryTypeFlags[memoryTypeIndex] & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		VK_ERROR(vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&block.mappedData)),
+		         "Failed to map device memory block");
+	}
+
+	// A new block is one free range covering all of it
+	if (!dedicated)
+	{
+		block.freeRanges.resize(orderCount);
+		block.freeRanges[orderCount - 1].insert(0);
+	}
+
+	++stats.blockCount;
+	stats.dedicatedBlockCount += dedicated ? 1 : 0;
+	stats.blockBytes += size;
+
+	// Reuse the slot of a released block, so block indices of live allocations stay valid
+	auto& typeBlocks = blocks[memoryTypeIndex];
+	for (uint32_t i = 0; i < typeBlocks.size(); ++i)
+	{
+		if (typeBlocks[i].memory == VK_NULL_HANDLE)
+		{
+			typeBlocks[i] = std::move(block);
+			return i;
+		}
+	}
+
+	typeBlocks.push_back(std::move(block));
+	return static_cast<uint32_t>(typeBlocks.size() - 1);
+}
+
+void DeviceMemoryAllocator::DestroyBlock(MemoryBlock& block)
+{
+	if (block.memory == VK_NULL_HANDLE) return;
+
+	// Freeing the memory also unmaps it
+	vkFreeMemory(device, block.memory, nullptr);
+
+	--stats.blockCount;
+	stats.dedicatedBlockCount -= block.dedicated ? 1 : 0;
+	stats.blockBytes -= block.size;
+
+	block = MemoryBlock();
+}
+
+bool DeviceMemoryAllocator::AllocateFromBlock(MemoryBlock& block, const uint32_t order, VkDeviceSize* offset) const
+{
+	// Find the smallest free range that fits
+	uint32_t freeOrder = order;
+	while (freeOrder < orderCount && block.freeRanges[freeOrder].empty())
+	{
+		++freeOrder;
+	}
+
+	if (freeOrder == orderCount) return false;
+
+	const auto range = block.freeRanges[freeOrder].begin();
+	*offset = *range;
+	block.freeRanges[freeOrder].erase(range);
+
+	// Split it down to the requested order, freeing the upper half each time
+	while (freeOrder > order)
+	{
+		--freeOrder;
+		block.freeRanges[freeOrder].insert(*offset + (minAllocationSize << freeOrder));
+	}
+
+	return true;
+}
+
+uint32_t DeviceMemoryAllocator::GetOrder(const VkDeviceSize size) const
+{
+	uint32_t order = 0;
+	while ((minAllocationSize << order) < size)
+	{
+		++order;
+	}
+	return order;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Range of device memory handed out by the DeviceMemoryAllocator, bind resources with memory + offset
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0; // size actually reserved for the range (rounded up)
+	void* mappedData = nullptr; // start of the range, only set for host visible memory
+
+	uint32_t memoryTypeIndex = 0;
+	uint32_t blockIndex = 0;
+};
+
+struct MemoryStats
+{
+	uint32_t blockCount = 0; // live vkAllocateMemory allocations
+	uint32_t dedicatedBlockCount = 0; // blocks holding a single allocation bigger than the block size
+	uint32_t allocationCount = 0; // live sub-allocations
+	VkDeviceSize blockBytes = 0; // bytes allocated from the device
+	VkDeviceSize usedBytes = 0; // bytes handed out to resources (after rounding)
+};
+
+// Sub-allocates resources from large device memory blocks (one set of blocks per memory type),
+// placing them in each block with a buddy allocator
+class DeviceMemoryAllocator
+{
+public:
+	static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	DeviceMemoryAllocator(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
+	                      VkDeviceSize newBlockSize = DEFAULT_BLOCK_SIZE);
+
+	// Allocations point back into the allocator's blocks, so it stays where it was created
+	DeviceMemoryAllocator(const DeviceMemoryAllocator& other) = delete;
+	DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator& other) = delete;
+	DeviceMemoryAllocator(DeviceMemoryAllocator&& other) = delete;
+	DeviceMemoryAllocator& operator=(DeviceMemoryAllocator&& other) = delete;
+
+	// Thread safe, assets may be loaded from several threads
+	MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties);
+	void Free(const MemoryAllocation& allocation);
+
+	MemoryStats GetStats() const;
+
+	void DestroyAllocator();
+
+private:
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint8_t* mappedData = nullptr; // host visible blocks are mapped for their whole lifetime
+		bool dedicated = false;
+		uint32_t allocationCount = 0; // an empty block is released unless it is its type's spare (see Free)
+
+		// Offsets of the free ranges of each order (a range of order n is minAllocationSize << n bytes)
+		std::vector<std::set<VkDeviceSize>> freeRanges;
+	};
+
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+
+	VkDeviceSize blockSize;
+	VkDeviceSize minAllocationSize; // also keeps linear and optimal resources on separate granularity pages
+	uint32_t orderCount;
+
+	std::vector<std::vector<MemoryBlock>> blocks; // [memory type][block]
+	std::vector<VkMemoryPropertyFlags> memoryTypeFlags;
+
+	MemoryStats stats;
+	mutable std::mutex allocatorMutex;
+
+	uint32_t CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated);
+	void DestroyBlock(MemoryBlock& block);
+	bool AllocateFromBlock(MemoryBlock& block, uint32_t order, VkDeviceSize* offset) const;
+	uint32_t GetOrder(VkDeviceSize size) const;
+};
@@ -0,0 +1,79 @@
+#include "DrawList.h"
+#include <array>
+#include <cstring>
+
+BindStats& BindStats::operator+=(const BindStats& other)
+{
+	pipelineBinds += other.pipelineBinds;
+	descriptorSetBinds += other.descriptorSetBinds;
+	bufferBinds += other.bufferBinds;
+	textureChanges += other.textureChanges;
+	draws += other.draws;
+	return *this;
+}
+
+uint64_t DrawList::MakeKey(const uint32_t pipeline, const uint32_t bufferIndex, const uint32_t texId, const float depth)
+{
+	// Bits of a positive float sort the same way as its value (anything behind the camera counts as 0)
+	const float clampedDepth = depth > 0.0f ? depth : 0.0f;
+	uint32_t depthBits;
+	memcpy(&depthBits, &clampedDepth, sizeof(depthBits));
+
+	return static_cast<uint64_t>(pipeline & 0xF) << 60 |
+		static_cast<uint64_t>(bufferIndex & 0xFFF) << 48 |
+		static_cast<uint64_t>(texId & 0xFFFF) << 32 |
+		depthBits;
+}
+
+void DrawList::Clear()
+{
+	items.clear();
+}
+
+void DrawList::Add(const uint64_t key, const uint32_t modelIndex, const uint32_t meshIndex, const uint32_t drawIndex)
+{
+	items.push_back({key, modelIndex, meshIndex, drawIndex});
+}
+
+void DrawList::Sort()
+{
+	sortScratch.resize(items.size());
+
+	// Least significant digit first, one byte per pass, so each pass keeps the order of the last (stable)
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		std::array<size_t, 256> counts{};
+		for (const auto& item : items)
+		{
+			++counts[(item.key >> shift) & 0xFF];
+		}
+
+		// Nothing to reorder when every key has the same byte here (unused texture / pipeline bits)
+		if (counts[(items.empty() ? 0 : items.front().key >> shift) & 0xFF] == items.size()) continue;
+
+		size_t offset = 0;
+		for (auto& count : counts)
+		{
+			const size_t bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+
+		for (const auto& item : items)
+		{
+			sortScratch[counts[(item.key >> shift) & 0xFF]++] = item;
+		}
+
+		items.swap(sortScratch);
+	}
+}
+
+const std::vector<DrawItem>& DrawList::GetItems() const
+{
+	return items;
+}
+
+size_t DrawList::GetCount() const
+{
+	return items.size();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// State changes recorded into one frame's command buffers
+struct BindStats
+{
+	uint32_t pipelineBinds = 0;
+	uint32_t descriptorSetBinds = 0;
+	uint32_t bufferBinds = 0; // vertex + index buffer pairs
+	uint32_t textureChanges = 0; // texture id pushes
+	uint32_t draws = 0;
+
+	BindStats& operator+=(const BindStats& other);
+};
+
+// One mesh to draw, with the key it is ordered by
+struct DrawItem
+{
+	uint64_t key;
+	uint32_t modelIndex;
+	uint32_t meshIndex;
+	uint32_t drawIndex; // position in model order (mesh by mesh through every model)
+};
+
+// Draws of one frame, optionally radix sorted by key so draws sharing state end up next to each other
+class DrawList
+{
+public:
+	// Most significant first: pipeline (4 bits), geometry buffer (12), texture (16), view depth (32, front to back)
+	static uint64_t MakeKey(uint32_t pipeline, uint32_t bufferIndex, uint32_t texId, float depth);
+
+	void Clear();
+	void Add(uint64_t key, uint32_t modelIndex, uint32_t meshIndex, uint32_t drawIndex);
+	void Sort();
+
+	const std::vector<DrawItem>& GetItems() const;
+	size_t GetCount() const;
+
+private:
+	std::vector<DrawItem> items;
+	std::vector<DrawItem> sortScratch; // kept between frames to avoid reallocating
+};
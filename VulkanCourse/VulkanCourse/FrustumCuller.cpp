@@ -0,0 +1,236 @@
+#include "FrustumCuller.h"
+#include <array>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE2
+#endif
+
+namespace
+{
+	// Boxes are tested this many at a time, the arrays are padded to a multiple of it
+	const size_t CULL_BATCH_WIDTH = 8;
+
+	// Frustum planes as (normal, distance), pointing inwards
+	struct FrustumPlanes
+	{
+		std::array<glm::vec4, 6> planes;
+		std::array<glm::vec3, 6> absNormals;
+	};
+
+	FrustumPlanes ExtractPlanes(const glm::mat4& viewProjection)
+	{
+		// glm is column major, so gather the rows (clip space depth is 0 to 1)
+		std::array<glm::vec4, 4> rows;
+		for (int i = 0; i < 4; ++i)
+		{
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+
+		FrustumPlanes frustum;
+		frustum.planes = {
+			rows[3] + rows[0], rows[3] - rows[0],
+			rows[3] + rows[1], rows[3] - rows[1],
+			rows[2], rows[3] - rows[2]
+		};
+
+		for (size_t i = 0; i < frustum.planes.size(); ++i)
+		{
+			frustum.absNormals[i] = glm::abs(glm::vec3(frustum.planes[i]));
+		}
+
+		return frustum;
+	}
+
+	// One box, with the operations in the same order as the SIMD kernels so every kernel gives the same result
+	bool IsBoxInside(const FrustumPlanes& frustum, const float cx, const float cy, const float cz, const float ex,
+	                 const float ey, const float ez)
+	{
+		for (size_t i = 0; i < frustum.planes.size(); ++i)
+		{
+			const glm::vec4& plane = frustum.planes[i];
+			const glm::vec3& absNormal = frustum.absNormals[i];
+
+			float distance = cx * plane.x + plane.w;
+			distance = distance + cy * plane.y;
+			distance = distance + cz * plane.z;
+
+			float radius = ex * absNormal.x;
+			radius = radius + ey * absNormal.y;
+			radius = radius + ez * absNormal.z;
+
+			if (!(distance + radius >= 0.0f)) return false;
+		}
+
+		return true;
+	}
+}
+
+FrustumCuller::FrustumCuller() : boxCount(0)
+{
+}
+
+void FrustumCuller::Resize(const size_t newBoxCount)
+{
+	boxCount = newBoxCount;
+
+	// Padding boxes are never reported, so their contents don't matter
+	const size_t paddedCount = (boxCount + CULL_BATCH_WIDTH - 1) / CULL_BATCH_WIDTH * CULL_BATCH_WIDTH;
+	centreX.resize(paddedCount);
+	centreY.resize(paddedCount);
+	centreZ.resize(paddedCount);
+	extentX.resize(paddedCount);
+	extentY.resize(paddedCount);
+	extentZ.resize(paddedCount);
+}
+
+size_t FrustumCuller::GetBoxCount() const
+{
+	return boxCount;
+}
+
+void FrustumCuller::SetBox(const size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                           const glm::mat4& transform)
+{
+	const glm::vec3 localCentre = (boundsMax + boundsMin) * 0.5f;
+	const glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+
+	// Smallest world space box around the transformed box
+	const glm::vec3 centre = glm::vec3(transform * glm::vec4(localCentre, 1.0f));
+	const glm::mat3 absTransform(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])),
+	                             glm::abs(glm::vec3(transform[2])));
+	const glm::vec3 extent = absTransform * localExtent;
+
+	centreX[index] = centre.x;
+	centreY[index] = centre.y;
+	centreZ[index] = centre.z;
+	extentX[index] = extent.x;
+	extentY[index] = extent.y;
+	extentZ[index] = extent.z;
+}
+
+void FrustumCuller::Cull(const glm::mat4& viewProjection, std::vector<uint8_t>& visible)
+{
+	const FrustumPlanes frustum = ExtractPlanes(viewProjection);
+
+	visible.resize(boxCount);
+	size_t visibleCount = 0;
+
+	// A box is outside when it is completely behind any one plane: distance + projected extent < 0
+	for (size_t first = 0; first < boxCount; first += CULL_BATCH_WIDTH)
+	{
+		uint32_t insideMask = 0;
+
+#if defined(FRUSTUM_CULLER_AVX)
+		const __m256 cx = _mm256_loadu_ps(&centreX[first]);
+		const __m256 cy = _mm256_loadu_ps(&centreY[first]);
+		const __m256 cz = _mm256_loadu_ps(&centreZ[first]);
+		const __m256 ex = _mm256_loadu_ps(&extentX[first]);
+		const __m256 ey = _mm256_loadu_ps(&extentY[first]);
+		const __m256 ez = _mm256_loadu_ps(&extentZ[first]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (size_t i = 0; i < frustum.planes.size(); ++i)
+		{
+			const glm::vec4& plane = frustum.planes[i];
+			const glm::vec3& absNormal = frustum.absNormals[i];
+
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(plane.y)));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane.z)));
+
+			__m256 radius = _mm256_mul_ps(ex, _mm256_set1_ps(absNormal.x));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(ey, _mm256_set1_ps(absNormal.y)));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(ez, _mm256_set1_ps(absNormal.z)));
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(),
+			                                             _CMP_GE_OQ));
+		}
+		insideMask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+#elif defined(FRUSTUM_CULLER_SSE2)
+		// Two groups of four per batch
+		for (size_t half = 0; half < CULL_BATCH_WIDTH; half += 4)
+		{
+			const size_t offset = first + half;
+			const __m128 cx = _mm_loadu_ps(&centreX[offset]);
+			const __m128 cy = _mm_loadu_ps(&centreY[offset]);
+			const __m128 cz = _mm_loadu_ps(&centreZ[offset]);
+			const __m128 ex = _mm_loadu_ps(&extentX[offset]);
+			const __m128 ey = _mm_loadu_ps(&extentY[offset]);
+			const __m128 ez = _mm_loadu_ps(&extentZ[offset]);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (size_t i = 0; i < frustum.planes.size(); ++i)
+			{
+				const glm::vec4& plane = frustum.planes[i];
+				const glm::vec3& absNormal = frustum.absNormals[i];
+
+				__m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+
+				__m128 radius = _mm_mul_ps(ex, _mm_set1_ps(absNormal.x));
+				radius = _mm_add_ps(radius, _mm_mul_ps(ey, _mm_set1_ps(absNormal.y)));
+				radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_set1_ps(absNormal.z)));
+
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+			insideMask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << half;
+		}
+#else
+		for (size_t lane = 0; lane < CULL_BATCH_WIDTH; ++lane)
+		{
+			const size_t box = first + lane;
+			const bool inside = IsBoxInside(frustum, centreX[box], centreY[box], centreZ[box], extentX[box],
+			                                extentY[box], extentZ[box]);
+			insideMask |= (inside ? 1u : 0u) << lane;
+		}
+#endif
+
+		const size_t laneCount = boxCount - first < CULL_BATCH_WIDTH ? boxCount - first : CULL_BATCH_WIDTH;
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			visible[first + lane] = static_cast<uint8_t>((insideMask >> lane) & 1u);
+			visibleCount += visible[first + lane];
+		}
+	}
+
+	stats.tested += boxCount;
+	stats.culled += boxCount - visibleCount;
+}
+
+void FrustumCuller::CullReference(const glm::mat4& viewProjection, std::vector<uint8_t>& visible) const
+{
+	const FrustumPlanes frustum = ExtractPlanes(viewProjection);
+
+	visible.resize(boxCount);
+	for (size_t box = 0; box < boxCount; ++box)
+	{
+		visible[box] = IsBoxInside(frustum, centreX[box], centreY[box], centreZ[box], extentX[box], extentY[box],
+		                           extentZ[box]) ? 1 : 0;
+	}
+}
+
+CullStats FrustumCuller::GetStats() const
+{
+	return stats;
+}
+
+void FrustumCuller::ResetStats()
+{
+	stats = CullStats();
+}
+
+const char* FrustumCuller::GetKernelName()
+{
+#if defined(FRUSTUM_CULLER_AVX)
+	return "avx";
+#elif defined(FRUSTUM_CULLER_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
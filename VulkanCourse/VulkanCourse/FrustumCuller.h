@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Running totals of culling work, since the last reset
+struct CullStats
+{
+	uint64_t tested = 0; // boxes tested against the frustum
+	uint64_t culled = 0; // boxes found to be completely outside it
+};
+
+// Tests world space bounding boxes against a view frustum, several boxes at a time with SSE / AVX
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Number of boxes tested by each Cull, box data is kept as one array per component (padded to the SIMD width)
+	void Resize(size_t newBoxCount);
+	size_t GetBoxCount() const;
+
+	// Store a local space box moved into world space by transform
+	void SetBox(size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& transform);
+
+	// visible[i] is set to 1 when box i is at least partly inside the frustum of viewProjection, 0 otherwise
+	void Cull(const glm::mat4& viewProjection, std::vector<uint8_t>& visible);
+	// Same test one box at a time without SIMD, and without counting it. Slow, it's there to check Cull against
+	void CullReference(const glm::mat4& viewProjection, std::vector<uint8_t>& visible) const;
+
+	CullStats GetStats() const;
+	void ResetStats();
+
+	// Instruction set the culling kernel was compiled for
+	static const char* GetKernelName();
+
+private:
+	size_t boxCount;
+
+	// Box centres and half sizes
+	std::vector<float> centreX, centreY, centreZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	CullStats stats;
+};
@@ -0,0 +1,212 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+GeometryPool::RangeList::RangeList(const uint32_t capacity)
+{
+	freeRanges[0] = capacity;
+}
+
+bool GeometryPool::RangeList::Allocate(const uint32_t count, uint32_t* offset)
+{
+	for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range)
+	{
+		if (range->second < count) continue;
+
+		*offset = range->first;
+
+		// Whatever is left of the range stays free
+		const uint32_t remaining = range->second - count;
+		freeRanges.erase(range);
+		if (remaining > 0)
+		{
+			freeRanges[*offset + count] = remaining;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void GeometryPool::RangeList::Free(uint32_t offset, uint32_t count)
+{
+	if (count == 0) return;
+
+	// Merge with the free range after this one
+	const auto next = freeRanges.find(offset + count);
+	if (next != freeRanges.end())
+	{
+		count += next->second;
+		freeRanges.erase(next);
+	}
+
+	// And with the one before it
+	auto range = freeRanges.lower_bound(offset);
+	if (range != freeRanges.begin())
+	{
+		--range;
+		if (range->first + range->second == offset)
+		{
+			range->second += count;
+			return;
+		}
+	}
+
+	freeRanges[offset] = count;
+}
+
+GeometryPool::GeometryPool(DeviceMemoryAllocator* newAllocator, VkDevice newDevice, const uint32_t newVertexCapacity,
+                           const uint32_t newIndexCapacity)
+	: allocator(newAllocator), device(newDevice), vertexCapacity(newVertexCapacity), indexCapacity(newIndexCapacity)
+{
+}
+
+GeometryRange GeometryPool::Upload(UploadQueue* uploadQueue, const Vertex* vertices, const uint32_t vertexCount,
+                                   const uint32_t* indices, const uint32_t indexCount,
+                                   const VertexQuantization& quantization)
+{
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+
+		// Find a buffer pair with room for both the vertices and the indices
+		bool found = false;
+		for (uint32_t i = 0; i < buffers.size() && !found; ++i)
+		{
+			if (!buffers[i].vertexRanges.Allocate(range.vertexCount, &range.vertexOffset)) continue;
+
+			if (!buffers[i].indexRanges.Allocate(range.indexCount, &range.firstIndex))
+			{
+				buffers[i].vertexRanges.Free(range.vertexOffset, range.vertexCount);
+				continue;
+			}
+
+			range.bufferIndex = i;
+			found = true;
+		}
+
+		if (!found)
+		{
+			// Meshes bigger than the default capacity get buffers big enough for them alone
+			range.bufferIndex = CreateBuffers(std::max(range.vertexCount, vertexCapacity),
+			                                  std::max(range.indexCount, indexCapacity));
+			buffers[range.bufferIndex].vertexRanges.Allocate(range.vertexCount, &range.vertexOffset);
+			buffers[range.bufferIndex].indexRanges.Allocate(range.indexCount, &range.firstIndex);
+		}
+	}
+
+	const VkDeviceSize vertexBytes = sizeof(DeviceVertex) * static_cast<VkDeviceSize>(range.vertexCount);
+	const VkDeviceSize indexBytes = sizeof(uint32_t) * static_cast<VkDeviceSize>(range.indexCount);
+
+	// "Stage" vertex and index data in the upload staging ring before transferring to GPU
+	const StagingAllocation staging = uploadQueue->AllocateStaging(vertexBytes + indexBytes);
+
+	uint8_t* stagingData = static_cast<uint8_t*>(staging.data);
+	DeviceVertex* stagingVertices = reinterpret_cast<DeviceVertex*>(stagingData);
+	for (uint32_t i = 0; i < range.vertexCount; ++i)
+	{
+		stagingVertices[i] = DeviceVertex::Pack(vertices[i], quantization);
+	}
+	memcpy(stagingData + vertexBytes, indices, static_cast<size_t>(indexBytes));
+
+	// Copy both into their ranges of the shared buffers
+	const VkCommandBuffer transferCommandBuffer = uploadQueue->Record();
+	{
+		VkBufferCopy vertexCopyRegion = {};
+		vertexCopyRegion.srcOffset = staging.offset;
+		vertexCopyRegion.dstOffset = sizeof(DeviceVertex) * static_cast<VkDeviceSize>(range.vertexOffset);
+		vertexCopyRegion.size = vertexBytes;
+
+		VkBufferCopy indexCopyRegion = {};
+		indexCopyRegion.srcOffset = staging.offset + vertexBytes;
+		indexCopyRegion.dstOffset = sizeof(uint32_t) * static_cast<VkDeviceSize>(range.firstIndex);
+		indexCopyRegion.size = indexBytes;
+
+		if (vertexBytes > 0)
+		{
+			vkCmdCopyBuffer(transferCommandBuffer, staging.buffer, GetVertexBuffer(range.bufferIndex), 1,
+			                &vertexCopyRegion);
+			uploadQueue->ReleaseBuffer(transferCommandBuffer, GetVertexBuffer(range.bufferIndex),
+			                           vertexCopyRegion.dstOffset, vertexBytes, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			                           VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		}
+
+		if (indexBytes > 0)
+		{
+			vkCmdCopyBuffer(transferCommandBuffer, staging.buffer, GetIndexBuffer(range.bufferIndex), 1,
+			                &indexCopyRegion);
+			uploadQueue->ReleaseBuffer(transferCommandBuffer, GetIndexBuffer(range.bufferIndex),
+			                           indexCopyRegion.dstOffset, indexBytes, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			                           VK_ACCESS_INDEX_READ_BIT);
+		}
+	}
+	range.uploadTicket = uploadQueue->GetRecordingTicket();
+
+	return range;
+}
+
+void GeometryPool::Free(const GeometryRange& range)
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+
+	buffers[range.bufferIndex].vertexRanges.Free(range.vertexOffset, range.vertexCount);
+	buffers[range.bufferIndex].indexRanges.Free(range.firstIndex, range.indexCount);
+}
+
+VkBuffer GeometryPool::GetVertexBuffer(const uint32_t bufferIndex) const
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return buffers[bufferIndex].vertexBuffer;
+}
+
+VkBuffer GeometryPool::GetIndexBuffer(const uint32_t bufferIndex) const
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return buffers[bufferIndex].indexBuffer;
+}
+
+uint32_t GeometryPool::GetBufferCount() const
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return static_cast<uint32_t>(buffers.size());
+}
+
+void GeometryPool::DestroyPool()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+
+	for (auto& geometryBuffers : buffers)
+	{
+		vkDestroyBuffer(device, geometryBuffers.vertexBuffer, nullptr);
+		allocator->Free(geometryBuffers.vertexBufferMemory);
+
+		vkDestroyBuffer(device, geometryBuffers.indexBuffer, nullptr);
+		allocator->Free(geometryBuffers.indexBufferMemory);
+	}
+
+	buffers.clear();
+}
+
+uint32_t GeometryPool::CreateBuffers(const uint32_t vertexCount, const uint32_t indexCount)
+{
+	GeometryBuffers geometryBuffers(vertexCount, indexCount);
+
+	// Buffers with transfer destination bit, to mark them as the recipients of the staged data
+	CreateBuffer(allocator, device, sizeof(DeviceVertex) * static_cast<VkDeviceSize>(vertexCount),
+	             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &geometryBuffers.vertexBuffer,
+	             &geometryBuffers.vertexBufferMemory);
+
+	CreateBuffer(allocator, device, sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCount),
+	             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+	             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &geometryBuffers.indexBuffer,
+	             &geometryBuffers.indexBufferMemory);
+
+	buffers.push_back(std::move(geometryBuffers));
+	return static_cast<uint32_t>(buffers.size() - 1);
+}
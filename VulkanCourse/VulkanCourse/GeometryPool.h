@@ -0,0 +1,93 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "UploadQueue.h"
+#include "Utilities.h"
+
+// Where a mesh's geometry lives inside the shared vertex / index buffers
+struct GeometryRange
+{
+	uint32_t bufferIndex = 0; // which pair of shared buffers
+	uint32_t vertexOffset = 0; // first vertex, added to every index when drawing
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint64_t uploadTicket = 0; // upload batch the data is copied in, see UploadQueue::Wait
+};
+
+// Large device local vertex and index buffers shared by all meshes, so a whole scene binds them once.
+// More buffer pairs are created when the existing ones are full.
+class GeometryPool
+{
+public:
+	static const uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20; // vertices per vertex buffer
+	static const uint32_t DEFAULT_INDEX_CAPACITY = 1 << 22; // indices per index buffer
+
+	GeometryPool(DeviceMemoryAllocator* newAllocator, VkDevice newDevice,
+	             uint32_t newVertexCapacity = DEFAULT_VERTEX_CAPACITY,
+	             uint32_t newIndexCapacity = DEFAULT_INDEX_CAPACITY);
+
+	// Ranges point into the pool's buffers, so it stays where it was created
+	GeometryPool(const GeometryPool& other) = delete;
+	GeometryPool& operator=(const GeometryPool& other) = delete;
+	GeometryPool(GeometryPool&& other) = delete;
+	GeometryPool& operator=(GeometryPool&& other) = delete;
+
+	// Reserve ranges for the mesh and record copies of its data into them through a staging buffer.
+	// Vertices are packed into DeviceVertex on the way (positions within the quantization's box)
+	GeometryRange Upload(UploadQueue* uploadQueue, const Vertex* vertices, uint32_t vertexCount,
+	                     const uint32_t* indices, uint32_t indexCount, const VertexQuantization& quantization);
+	void Free(const GeometryRange& range);
+
+	VkBuffer GetVertexBuffer(uint32_t bufferIndex) const;
+	VkBuffer GetIndexBuffer(uint32_t bufferIndex) const;
+	uint32_t GetBufferCount() const;
+
+	void DestroyPool();
+
+private:
+	// First fit list of free element ranges (offset -> count), neighbours are merged when freed
+	class RangeList
+	{
+	public:
+		explicit RangeList(uint32_t capacity);
+
+		bool Allocate(uint32_t count, uint32_t* offset);
+		void Free(uint32_t offset, uint32_t count);
+
+	private:
+		std::map<uint32_t, uint32_t> freeRanges;
+	};
+
+	struct GeometryBuffers
+	{
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation vertexBufferMemory;
+		RangeList vertexRanges;
+
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation indexBufferMemory;
+		RangeList indexRanges;
+
+		GeometryBuffers(uint32_t vertexCapacity, uint32_t indexCapacity)
+			: vertexRanges(vertexCapacity), indexRanges(indexCapacity)
+		{
+		}
+	};
+
+	DeviceMemoryAllocator* allocator;
+	VkDevice device;
+
+	uint32_t vertexCapacity;
+	uint32_t indexCapacity;
+
+	std::vector<GeometryBuffers> buffers;
+	mutable std::mutex poolMutex;
+
+	uint32_t CreateBuffers(uint32_t vertexCount, uint32_t indexCount);
+};
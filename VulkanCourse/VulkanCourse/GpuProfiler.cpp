@@ -0,0 +1,136 @@
+#include "GpuProfiler.h"
+
+#include <array>
+#include <cstdio>
+#include "Utilities.h"
+
+GpuProfiler::GpuProfiler()
+	: device(nullptr), queryPool(VK_NULL_HANDLE), slotCount(0), timestampPeriod(0.0), timestampMask(0),
+	  logInterval(0), framesSinceLog(0)
+{
+}
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice newDevice, const uint32_t queueFamily,
+                         const uint32_t newSlotCount)
+	: device(newDevice), queryPool(VK_NULL_HANDLE), slotCount(newSlotCount), timestampPeriod(0.0),
+	  timestampMask(0), logInterval(0), framesSinceLog(0)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyList.data());
+
+	// Queue family must support timestamps at all, otherwise the profiler stays disabled
+	const uint32_t validBits = queueFamilyList[queueFamily].timestampValidBits;
+	if (validBits == 0) return;
+
+	timestampPeriod = deviceProperties.limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+	// One group of timestamps per slot, so slots can be in flight at the same time
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = slotCount * TIMESTAMP_COUNT;
+
+	VK_ERROR(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool),
+	         "Failed to create timestamp query pool");
+
+	slotPending.resize(slotCount, false);
+	slotFrame.resize(slotCount, 0);
+}
+
+bool GpuProfiler::IsSupported() const
+{
+	return queryPool != VK_NULL_HANDLE;
+}
+
+void GpuProfiler::ResetSlot(VkCommandBuffer commandBuffer, const uint32_t slot) const
+{
+	if (!IsSupported()) return;
+
+	// Queries must be reset before they are written again (and outside of a render pass)
+	vkCmdResetQueryPool(commandBuffer, queryPool, slot * TIMESTAMP_COUNT, TIMESTAMP_COUNT);
+}
+
+void GpuProfiler::WriteTimestamp(VkCommandBuffer commandBuffer, const uint32_t slot, const Timestamp timestamp,
+                                 const VkPipelineStageFlagBits stage) const
+{
+	if (!IsSupported()) return;
+
+	vkCmdWriteTimestamp(commandBuffer, stage, queryPool, slot * TIMESTAMP_COUNT + timestamp);
+}
+
+void GpuProfiler::MarkSubmitted(const uint32_t slot, const uint64_t frameNumber)
+{
+	if (!IsSupported()) return;
+
+	slotPending[slot] = true;
+	slotFrame[slot] = frameNumber;
+}
+
+void GpuProfiler::CollectResults()
+{
+	if (!IsSupported()) return;
+
+	for (uint32_t slot = 0; slot < slotCount; ++slot)
+	{
+		if (!slotPending[slot]) continue;
+
+		// Don't wait for results: anything still executing is simply picked up on a later frame
+		std::array<uint64_t, TIMESTAMP_COUNT> timestamps{};
+		const VkResult result = vkGetQueryPoolResults(device, queryPool, slot * TIMESTAMP_COUNT, TIMESTAMP_COUNT,
+		                                              sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+		                                              VK_QUERY_RESULT_64_BIT);
+		if (result == VK_NOT_READY) continue;
+		VK_ERROR(result, "Failed to read back timestamp queries");
+
+		slotPending[slot] = false;
+
+		// Slots can complete out of order, only keep the newest frame
+		if (latestTimings.valid && slotFrame[slot] < latestTimings.frameNumber) continue;
+
+		latestTimings.valid = true;
+		latestTimings.frameNumber = slotFrame[slot];
+		latestTimings.cullMs = TicksToMs(timestamps[COMMAND_BUFFER_BEGIN], timestamps[CULL_END]);
+		latestTimings.geometryMs = TicksToMs(timestamps[GEOMETRY_BEGIN], timestamps[GEOMETRY_END]);
+		latestTimings.compositeMs = TicksToMs(timestamps[GEOMETRY_END], timestamps[COMPOSITE_END]);
+		latestTimings.commandBufferMs = TicksToMs(timestamps[COMMAND_BUFFER_BEGIN], timestamps[COMMAND_BUFFER_END]);
+
+		if (logInterval > 0 && ++framesSinceLog >= logInterval)
+		{
+			framesSinceLog = 0;
+			printf("GPU frame %llu: cull %.3f ms, geometry %.3f ms, composite %.3f ms, command buffer %.3f ms\n",
+			       static_cast<unsigned long long>(latestTimings.frameNumber), latestTimings.cullMs,
+			       latestTimings.geometryMs, latestTimings.compositeMs, latestTimings.commandBufferMs);
+		}
+	}
+}
+
+GpuTimings GpuProfiler::GetTimings() const
+{
+	return latestTimings;
+}
+
+void GpuProfiler::SetLogInterval(const uint32_t frames)
+{
+	logInterval = frames;
+	framesSinceLog = 0;
+}
+
+void GpuProfiler::DestroyProfiler()
+{
+	if (!IsSupported()) return;
+
+	vkDestroyQueryPool(device, queryPool, nullptr);
+	queryPool = VK_NULL_HANDLE;
+}
+
+double GpuProfiler::TicksToMs(const uint64_t begin, const uint64_t end) const
+{
+	const uint64_t ticks = ((end & timestampMask) - (begin & timestampMask)) & timestampMask;
+	return static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+}
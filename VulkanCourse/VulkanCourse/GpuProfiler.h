@@ -0,0 +1,69 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+
+// GPU times (in milliseconds) of one submitted command buffer
+struct GpuTimings
+{
+	bool valid = false; // false until the first results have been read back
+	uint64_t frameNumber = 0; // frame the timings were recorded in
+	double cullMs = 0.0; // compute culling pre-pass (zero when culling on the GPU is off)
+	double geometryMs = 0.0; // first subpass (mesh drawing)
+	double compositeMs = 0.0; // second subpass (full-screen input attachment pass)
+	double commandBufferMs = 0.0; // whole command buffer
+};
+
+class GpuProfiler
+{
+public:
+	// Points in the command buffer that get a timestamp
+	enum Timestamp : uint32_t
+	{
+		COMMAND_BUFFER_BEGIN,
+		CULL_END,
+		GEOMETRY_BEGIN,
+		GEOMETRY_END,
+		COMPOSITE_END,
+		COMMAND_BUFFER_END,
+		TIMESTAMP_COUNT
+	};
+
+	GpuProfiler();
+	GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamily, uint32_t newSlotCount);
+
+	bool IsSupported() const;
+
+	// - Recording (one slot per command buffer)
+	void ResetSlot(VkCommandBuffer commandBuffer, uint32_t slot) const;
+	void WriteTimestamp(VkCommandBuffer commandBuffer, uint32_t slot, Timestamp timestamp,
+	                    VkPipelineStageFlagBits stage) const;
+
+	// - Submission / read back
+	void MarkSubmitted(uint32_t slot, uint64_t frameNumber);
+	void CollectResults();
+
+	GpuTimings GetTimings() const;
+	void SetLogInterval(uint32_t frames);
+
+	void DestroyProfiler();
+
+private:
+	VkDevice device;
+	VkQueryPool queryPool;
+
+	uint32_t slotCount;
+	double timestampPeriod; // nanoseconds per timestamp tick
+	uint64_t timestampMask; // only the valid bits of each timestamp are meaningful
+
+	std::vector<bool> slotPending; // slot has been submitted but its results not read yet
+	std::vector<uint64_t> slotFrame;
+
+	GpuTimings latestTimings;
+
+	uint32_t logInterval;
+	uint32_t framesSinceLog;
+
+	double TicksToMs(uint64_t begin, uint64_t end) const;
+};
@@ -1,16 +1,20 @@
 ﻿#include "Mesh.h"
 
 Mesh::Mesh()
-	: model({glm::mat4(1.0f)}), texId(), vertexCount(0), vertexBuffer(0), vertexBufferMemory(0), indexCount(0), physicalDevice(nullptr), device(nullptr)
+	: model({glm::mat4(1.0f)}), texId(), vertexCount(0), indexCount(0), boundsMin(0.0f), boundsMax(0.0f),
+	  geometryPool(nullptr)
 {
 }
 
-Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-           VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int newTexId)
-	: model({glm::mat4(1.0f)}), texId(newTexId), vertexCount(vertices->size()), indexCount(indices->size()), physicalDevice(newPhysicalDevice), device(newDevice)
+Mesh::Mesh(GeometryPool* newGeometryPool, UploadQueue* uploadQueue, const Vertex* vertices,
+           const uint32_t newVertexCount, const uint32_t* indices, const uint32_t newIndexCount,
+           const glm::vec3 newBoundsMin, const glm::vec3 newBoundsMax, const VertexQuantization& quantization,
+           const int newTexId)
+	: model({glm::mat4(1.0f)}), texId(newTexId), vertexCount(newVertexCount), indexCount(newIndexCount),
+	  boundsMin(newBoundsMin), boundsMax(newBoundsMax), geometryPool(newGeometryPool)
 {
-	CreateVertexBuffer(transferQueue, transferCommandPool, vertices);
-	CreateIndexBuffer(transferQueue, transferCommandPool, indices);
+	geometryRange = geometryPool->Upload(uploadQueue, vertices, newVertexCount, indices, newIndexCount,
+	                                     quantization);
 }
 
 void Mesh::SetModel(const glm::mat4 newModel)
@@ -40,102 +44,51 @@ int Mesh::GetIndexCount() const
 
 VkBuffer Mesh::GetVertexBuffer() const
 {
-	return vertexBuffer;
+	return geometryPool->GetVertexBuffer(geometryRange.bufferIndex);
 }
 
 VkBuffer Mesh::GetIndexBuffer() const
 {
-	return indexBuffer;
+	return geometryPool->GetIndexBuffer(geometryRange.bufferIndex);
 }
 
-int Mesh::GetTexId() const
+uint32_t Mesh::GetBufferIndex() const
 {
-	return texId;
+	return geometryRange.bufferIndex;
 }
 
-void Mesh::SetTexId(const int newId)
+uint32_t Mesh::GetVertexOffset() const
 {
-	texId = newId;
+	return geometryRange.vertexOffset;
 }
 
-void Mesh::DestroyMeshBuffers() const
+uint32_t Mesh::GetFirstIndex() const
 {
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
-
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	return geometryRange.firstIndex;
 }
 
-void Mesh::CreateVertexBuffer(VkQueue transferQueue, const VkCommandPool transferCommandPool, std::vector<Vertex>* vertices)
+glm::vec3 Mesh::GetBoundsMin() const
 {
-	const VkDeviceSize bufferSize = static_cast<VkDeviceSize>(sizeof(Vertex)) * vertices->size();
-
-	// Temporary buffer to "stage" vertex data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	// Create buffer and allocate memory to it
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-	             &stagingBufferMemory);
-
-	// Map memory to vertex buffer
-	// 1. Create pointer to a point in normal memory
-	void* data; 
-	// 2. map the vertex buffer memory to that point	
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	// 3. Copy memory from vertices vector to the point										
-	memcpy(data, vertices->data(), static_cast<size_t>(bufferSize));
-	// 4. unmap the vertex buffer memory
-	vkUnmapMemory(device, stagingBufferMemory);
-
-	// Create buffer with transfer destination bit, to mark as the recipient of the transfer data
-	CreateBuffer(physicalDevice, device, bufferSize,
-	             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
-
-	// Copy staging buffer to the vertex buffer on the GPU
-	CopyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-	// Clean up staging buffer parts
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	return boundsMin;
 }
 
-void Mesh::CreateIndexBuffer(VkQueue transferQueue, const VkCommandPool transferCommandPool, std::vector<uint32_t>* indices)
+glm::vec3 Mesh::GetBoundsMax() const
 {
-	const VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
-
-	// Temporary buffer to "stage" index data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	// Create buffer and allocate memory to it
-	CreateBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-	             &stagingBufferMemory);
-
-	// Map memory to Index buffer
-	// 1. Create pointer to a point in normal memory
-	void* data; 
-	// 2. map the vertex buffer memory to that point	
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	// 3. Copy memory from vertices vector to the point										
-	memcpy(data, indices->data(), static_cast<size_t>(bufferSize));
-	// 4. unmap the vertex buffer memory
-	vkUnmapMemory(device, stagingBufferMemory);
+	return boundsMax;
+}
 
-	
-	// Create buffer for index data on GPU
-	CreateBuffer(physicalDevice, device, bufferSize,
-	             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-	             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer, &indexBufferMemory);
+int Mesh::GetTexId() const
+{
+	return texId;
+}
 
-	// Copy from staging buffer to GPU access buffer
-	CopyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, indexBuffer, bufferSize);
+void Mesh::SetTexId(const int newId)
+{
+	texId = newId;
+}
 
-	// Destroy and release staging buffer resources
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+void Mesh::DestroyMeshBuffers() const
+{
+	// Only gives the ranges back, the shared buffers belong to the pool
+	geometryPool->Free(geometryRange);
 }
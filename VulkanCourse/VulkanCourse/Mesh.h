@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vector>
+#include "GeometryPool.h"
 #include "Utilities.h"
 
 struct Model
@@ -17,19 +18,21 @@ class Mesh
 	int texId;
 	
 	int vertexCount;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-
 	int indexCount;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
 
-	VkPhysicalDevice physicalDevice;
-	VkDevice device;
+	// Local space bounding box of the vertices, for culling
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	// Vertex and index data live in ranges of the shared geometry buffers
+	GeometryPool* geometryPool;
+	GeometryRange geometryRange;
 public:
 	Mesh();
-	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-	     VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int newTexId);
+	// Vertices are packed into the device layout as they're staged, positions within the quantization's box
+	Mesh(GeometryPool* newGeometryPool, UploadQueue* uploadQueue, const Vertex* vertices, uint32_t newVertexCount,
+	     const uint32_t* indices, uint32_t newIndexCount, glm::vec3 newBoundsMin, glm::vec3 newBoundsMax,
+	     const VertexQuantization& quantization, int newTexId);
 
 	void SetModel(glm::mat4 newModel);
 	glm::mat4 GetModelMat() const;
@@ -40,12 +43,16 @@ public:
 	VkBuffer GetVertexBuffer() const;
 	VkBuffer GetIndexBuffer() const;
 
+	// Position of the mesh in the shared buffers, for binding once and drawing with offsets
+	uint32_t GetBufferIndex() const;
+	uint32_t GetVertexOffset() const;
+	uint32_t GetFirstIndex() const;
+
+	glm::vec3 GetBoundsMin() const;
+	glm::vec3 GetBoundsMax() const;
+
 	int GetTexId() const;
 	void SetTexId(int newId);
 	
 	void DestroyMeshBuffers() const;
-
-private:
-	void CreateVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
-	void CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
 };
@@ -0,0 +1,319 @@
+#include "MeshCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Bumped whenever the layout changes, older files are then imported again
+	const uint32_t CACHE_VERSION = 4; // 2: vertex colours are imported, 4: keyed on source size and time
+	const char CACHE_MAGIC[4] = {'V', 'K', 'M', 'C'};
+	const size_t DATA_ALIGNMENT = 16;
+
+	// Layout: header, one record per mesh, texture names (length + characters),
+	// then the vertices and indices of every mesh, each aligned to DATA_ALIGNMENT
+	struct FileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t importerFlags;
+		uint32_t vertexSize; // so a change to Vertex invalidates old files too
+		uint32_t materialCount;
+		uint32_t meshCount;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint64_t sourceHash; // of the model file's contents, checked when only its modification time has changed
+		uint64_t fileSize; // of the whole cooked file, so a cut off one isn't loaded
+	};
+
+	struct MeshRecord
+	{
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t materialIndex;
+		float boundsMin[3];
+		float boundsMax[3];
+		uint32_t padding;
+	};
+
+	size_t AlignUp(const size_t offset)
+	{
+		return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+	}
+
+	// Whether count elements of elementSize starting at offset fit in a file of fileSize bytes
+	bool FitsInFile(const uint64_t offset, const uint64_t count, const size_t elementSize, const size_t fileSize)
+	{
+		return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+	}
+
+	// Size and modification time of a file, false when it can't be read
+	bool GetFileStamp(const std::string& fileName, uint64_t* size, int64_t* modifiedTime)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExA(fileName.c_str(), GetFileExInfoStandard, &attributes)) return false;
+
+		*size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+		*modifiedTime = static_cast<int64_t>((static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+			attributes.ftLastWriteTime.dwLowDateTime);
+#else
+		struct stat fileStat;
+		if (stat(fileName.c_str(), &fileStat) != 0) return false;
+
+		*size = static_cast<uint64_t>(fileStat.st_size);
+		*modifiedTime = static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+#endif
+		return true;
+	}
+
+	// false when the file can't be read
+	bool HashFile(const std::string& fileName, uint64_t* hash)
+	{
+		MappedFile source;
+		if (!source.Open(fileName)) return false;
+
+		*hash = HashBytes(source.GetData(), source.GetSize());
+		return true;
+	}
+
+	// Unique per write, so loads of the same model cooking at the same time never write into one file
+	std::string MakeTempFileName(const std::string& cacheFile)
+	{
+		static std::atomic<uint32_t> writeCount{0};
+
+#ifdef _WIN32
+		const unsigned long processId = GetCurrentProcessId();
+#else
+		const unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+
+		return cacheFile + "." + std::to_string(processId) + "." + std::to_string(writeCount++) + ".tmp";
+	}
+
+	// Moves the written file over the cooked one in a single step, so a reader sees either the old or the new file
+	bool MoveIntoPlace(const std::string& tempFile, const std::string& cacheFile)
+	{
+#ifdef _WIN32
+		return MoveFileExA(tempFile.c_str(), cacheFile.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(tempFile.c_str(), cacheFile.c_str()) == 0;
+#endif
+	}
+}
+
+std::string MeshCache::GetCacheFileName(const std::string& modelFile)
+{
+	return modelFile + ".meshcache";
+}
+
+MeshCacheKey MeshCache::MakeKey(const std::string& modelFile, const uint32_t importerFlags)
+{
+	MeshCacheKey key;
+	if (!GetFileStamp(modelFile, &key.sourceSize, &key.sourceModifiedTime))
+	{
+		throw std::runtime_error("Failed to load model! (" + modelFile + ")");
+	}
+	key.importerFlags = importerFlags;
+
+	return key;
+}
+
+bool MeshCache::Open(const std::string& modelFile, const MeshCacheKey& key)
+{
+	textureNames.clear();
+	meshes.clear();
+
+	if (!file.Open(GetCacheFileName(modelFile))) return false;
+
+	const uint8_t* data = file.GetData();
+	const size_t size = file.GetSize();
+
+	// Anything that doesn't match (or doesn't fit) means the file is stale or broken, so it's imported again
+	FileHeader header = {};
+	if (size >= sizeof(header)) memcpy(&header, data, sizeof(header));
+
+	if (size < sizeof(header) || memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION ||
+		header.vertexSize != sizeof(Vertex) || header.importerFlags != key.importerFlags ||
+		header.sourceSize != key.sourceSize || header.fileSize != size ||
+		!FitsInFile(sizeof(header), header.meshCount, sizeof(MeshRecord), size))
+	{
+		file.Close();
+		return false;
+	}
+
+	// Same size but touched since it was cooked, only the contents can tell whether it really changed
+	uint64_t sourceHash = 0;
+	if (header.sourceModifiedTime != key.sourceModifiedTime &&
+		(!HashFile(modelFile, &sourceHash) || sourceHash != header.sourceHash))
+	{
+		file.Close();
+		return false;
+	}
+
+	size_t offset = sizeof(header) + sizeof(MeshRecord) * static_cast<size_t>(header.meshCount);
+
+	bool valid = true;
+
+	textureNames.resize(header.materialCount);
+	for (uint32_t i = 0; i < header.materialCount && valid; ++i)
+	{
+		uint32_t length = 0;
+		valid = FitsInFile(offset, 1, sizeof(length), size);
+		if (valid) memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+
+		valid = valid && FitsInFile(offset, length, 1, size);
+		if (valid) textureNames[i].assign(reinterpret_cast<const char*>(data + offset), length);
+		offset += length;
+	}
+
+	meshes.resize(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount && valid; ++i)
+	{
+		MeshRecord record;
+		memcpy(&record, data + sizeof(header) + sizeof(MeshRecord) * i, sizeof(record));
+
+		valid = record.vertexOffset % DATA_ALIGNMENT == 0 && record.indexOffset % DATA_ALIGNMENT == 0 &&
+			FitsInFile(record.vertexOffset, record.vertexCount, sizeof(Vertex), size) &&
+			FitsInFile(record.indexOffset, record.indexCount, sizeof(uint32_t), size) &&
+			record.materialIndex < header.materialCount;
+
+		CachedMesh& mesh = meshes[i];
+		mesh.vertices = reinterpret_cast<const Vertex*>(data + record.vertexOffset);
+		mesh.vertexCount = record.vertexCount;
+		mesh.indices = reinterpret_cast<const uint32_t*>(data + record.indexOffset);
+		mesh.indexCount = record.indexCount;
+		mesh.materialIndex = record.materialIndex;
+		mesh.boundsMin = {record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]};
+		mesh.boundsMax = {record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]};
+	}
+
+	if (!valid)
+	{
+		textureNames.clear();
+		meshes.clear();
+		file.Close();
+		return false;
+	}
+
+	return true;
+}
+
+const std::vector<std::string>& MeshCache::GetTextureNames() const
+{
+	return textureNames;
+}
+
+const std::vector<CachedMesh>& MeshCache::GetMeshes() const
+{
+	return meshes;
+}
+
+bool MeshCache::Write(const std::string& modelFile, const MeshCacheKey& key,
+                      const std::vector<std::string>& textureNames, const std::vector<MeshData>& meshes)
+{
+	FileHeader header = {};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.sourceSize = key.sourceSize;
+	header.sourceModifiedTime = key.sourceModifiedTime;
+	header.importerFlags = key.importerFlags;
+	header.vertexSize = sizeof(Vertex);
+	header.materialCount = static_cast<uint32_t>(textureNames.size());
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+
+	// Work out where every mesh's data goes before anything is written
+	size_t offset = sizeof(header) + sizeof(MeshRecord) * meshes.size();
+	for (const auto& textureName : textureNames)
+	{
+		offset += sizeof(uint32_t) + textureName.size();
+	}
+
+	std::vector<MeshRecord> records(meshes.size());
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const MeshData& mesh = meshes[i];
+		MeshRecord& record = records[i];
+		record = {};
+
+		offset = AlignUp(offset);
+		record.vertexOffset = offset;
+		record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		offset += sizeof(Vertex) * mesh.vertices.size();
+
+		offset = AlignUp(offset);
+		record.indexOffset = offset;
+		record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		offset += sizeof(uint32_t) * mesh.indices.size();
+
+		record.materialIndex = mesh.materialIndex;
+
+		memcpy(record.boundsMin, &mesh.boundsMin, sizeof(record.boundsMin));
+		memcpy(record.boundsMax, &mesh.boundsMax, sizeof(record.boundsMax));
+	}
+
+	header.fileSize = offset;
+
+	// Cooking happens on a loading thread after an import, which has read the model file anyway
+	if (!HashFile(modelFile, &header.sourceHash)) return false;
+
+	// Written under a temporary name and moved into place, so a half written file is never opened
+	const std::string cacheFile = GetCacheFileName(modelFile);
+	const std::string tempFile = MakeTempFileName(cacheFile);
+	{
+		std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+		if (!stream.is_open()) return false;
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(records.data()), sizeof(MeshRecord) * records.size());
+
+		for (const auto& textureName : textureNames)
+		{
+			const uint32_t length = static_cast<uint32_t>(textureName.size());
+			stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			stream.write(textureName.data(), length);
+		}
+
+		const char padding[DATA_ALIGNMENT] = {};
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			stream.write(padding, records[i].vertexOffset - static_cast<uint64_t>(stream.tellp()));
+			stream.write(reinterpret_cast<const char*>(meshes[i].vertices.data()),
+			             sizeof(Vertex) * meshes[i].vertices.size());
+
+			stream.write(padding, records[i].indexOffset - static_cast<uint64_t>(stream.tellp()));
+			stream.write(reinterpret_cast<const char*>(meshes[i].indices.data()),
+			             sizeof(uint32_t) * meshes[i].indices.size());
+		}
+
+		if (!stream.good())
+		{
+			stream.close();
+			std::remove(tempFile.c_str());
+			return false;
+		}
+	}
+
+	if (!MoveIntoPlace(tempFile, cacheFile))
+	{
+		std::remove(tempFile.c_str());
+		return false;
+	}
+
+	return true;
+}
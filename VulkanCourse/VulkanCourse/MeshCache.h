@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshModel.h"
+
+// A cooked file is only used when these match the model file it's loaded for. Size and modification time are
+// cheap to read, the contents are only hashed (against the hash stored in the cooked file) when the time differs
+struct MeshCacheKey
+{
+	uint64_t sourceSize = 0;
+	int64_t sourceModifiedTime = 0;
+	uint32_t importerFlags = 0;
+};
+
+// Mesh of a cooked file, its vertices and indices point into the mapping
+struct CachedMesh
+{
+	const Vertex* vertices = nullptr;
+	uint32_t vertexCount = 0;
+	const uint32_t* indices = nullptr;
+	uint32_t indexCount = 0;
+	uint32_t materialIndex = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Converted meshes and material textures of a model, cooked into a binary file next to it on the first import.
+// Later loads map the cooked file and upload straight out of it, without running Assimp or converting anything.
+class MeshCache
+{
+public:
+	static std::string GetCacheFileName(const std::string& modelFile);
+	static MeshCacheKey MakeKey(const std::string& modelFile, uint32_t importerFlags); // doesn't read the file
+
+	// Map the cooked file of the model, false when there is none or it was cooked from something else
+	bool Open(const std::string& modelFile, const MeshCacheKey& key);
+
+	const std::vector<std::string>& GetTextureNames() const; // one per material, empty when it has no texture
+	const std::vector<CachedMesh>& GetMeshes() const; // in draw order
+
+	// Replaces any cooked file the model already has, false when it couldn't be written. Reads the whole model file
+	static bool Write(const std::string& modelFile, const MeshCacheKey& key,
+	                  const std::vector<std::string>& textureNames, const std::vector<MeshData>& meshes);
+
+private:
+	MappedFile file;
+	std::vector<std::string> textureNames;
+	std::vector<CachedMesh> meshes;
+};
@@ -32,30 +32,24 @@ std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
 	return textureList;
 }
 
-std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-                                      VkCommandPool commandPool, aiNode* node, const aiScene* scene, std::vector<int>& matToTex)
+void MeshModel::CollectMeshes(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes)
 {
-	std::vector<Mesh> meshList;
-
 	for (size_t i = 0; i < node->mNumMeshes; ++i)
 	{
-		meshList.push_back(LoadMesh(newPhysicalDevice, newDevice, transferQueue, commandPool, scene->mMeshes[node->mMeshes[i]], matToTex));
+		meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
 	}
 
 	for (size_t i = 0; i < node->mNumChildren; ++i)
 	{
-		std::vector<Mesh> childList = LoadNode(newPhysicalDevice, newDevice, transferQueue, commandPool, node->mChildren[i], scene, matToTex);
-		meshList.insert(meshList.end(), childList.begin(), childList.end());
+		CollectMeshes(node->mChildren[i], scene, meshes);
 	}
-
-	return meshList;
 }
 
-Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-	VkCommandPool commandPool, aiMesh* mesh, std::vector<int> matToTex)
+MeshData MeshModel::ConvertMesh(const aiMesh* mesh)
 {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	MeshData meshData;
+	std::vector<Vertex>& vertices = meshData.vertices;
+	std::vector<uint32_t>& indices = meshData.indices;
 
 	vertices.resize(mesh->mNumVertices);
 
@@ -72,10 +66,29 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
 			vertices[i].tex = {0.0f, 0.0f};
 		}
 
-		vertices[i].col = {1.0f, 1.0f, 1.0f};
+		if (mesh->mColors[0])
+		{
+			vertices[i].col = {mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b};
+		}
+		else
+		{
+			vertices[i].col = {1.0f, 1.0f, 1.0f};
+		}
+	}
+
+	// Local space bounding box, for culling and for quantizing the positions
+	if (!vertices.empty())
+	{
+		meshData.boundsMin = meshData.boundsMax = vertices.front().pos;
+		for (const auto& vertex : vertices)
+		{
+			meshData.boundsMin = glm::min(meshData.boundsMin, vertex.pos);
+			meshData.boundsMax = glm::max(meshData.boundsMax, vertex.pos);
+		}
 	}
 
 	// Iterate over indices through faces and copy across
+	indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
 	for (size_t i = 0; i < mesh->mNumFaces; ++i)
 	{
 		// get face
@@ -87,9 +100,9 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
 		}
 	}
 
-	return Mesh(newPhysicalDevice, newDevice, transferQueue, commandPool, &vertices, &indices, matToTex[mesh->mMaterialIndex]);
+	meshData.materialIndex = mesh->mMaterialIndex;
 
-	
+	return meshData;
 }
 
 MeshModel::MeshModel(): model()
@@ -106,6 +119,22 @@ MeshModel::~MeshModel()
 	DestroyMeshModel();
 }
 
+void MeshModel::SetMeshList(std::vector<Mesh> newMeshList)
+{
+	DestroyMeshModel();
+	meshList = std::move(newMeshList);
+}
+
+void MeshModel::SetVertexQuantization(const VertexQuantization& newVertexQuantization)
+{
+	vertexQuantization = newVertexQuantization;
+}
+
+const VertexQuantization& MeshModel::GetVertexQuantization() const
+{
+	return vertexQuantization;
+}
+
 size_t MeshModel::GetMeshCount() const
 {
 	return meshList.size();
@@ -3,10 +3,21 @@
 
 #include "Mesh.h"
 
+// Vertices and indices of one mesh converted from Assimp's layout, ready to upload
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t materialIndex = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f); // of the vertex positions
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
 class MeshModel
 {
 	std::vector<Mesh> meshList;
 	glm::mat4 model;
+	VertexQuantization vertexQuantization; // every mesh's positions are packed within it
 
 public:
 	MeshModel();
@@ -14,13 +25,21 @@ public:
 
 	~MeshModel();
 
-	static std::vector<std::string> LoadMaterials(const aiScene* scene);
-	static std::vector<Mesh> LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-	                                  VkCommandPool commandPool, aiNode* node, const aiScene* scene,
-	                                  std::vector<int>& matToTex);
-	static Mesh LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-	                                  VkCommandPool commandPool, aiMesh* mesh, std::vector<int> matToTex);
+	// Meshes own GPU buffers, so a model can be moved (e.g. when modelList grows) but never copied
+	MeshModel(const MeshModel& other) = delete;
+	MeshModel& operator=(const MeshModel& other) = delete;
+	MeshModel(MeshModel&& other) noexcept = default;
+	MeshModel& operator=(MeshModel&& other) noexcept = default;
 
+	static std::vector<std::string> LoadMaterials(const aiScene* scene);
+	// Every mesh under node, in the order they are drawn
+	static void CollectMeshes(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes);
+	// Only reads the mesh, so meshes of one scene can be converted on different threads
+	static MeshData ConvertMesh(const aiMesh* mesh);
+
+	void SetMeshList(std::vector<Mesh> newMeshList);
+	void SetVertexQuantization(const VertexQuantization& newVertexQuantization);
+	const VertexQuantization& GetVertexQuantization() const;
 	size_t GetMeshCount() const;
 	Mesh* GetMesh(size_t index);
 
@@ -1,14 +1,21 @@
 #version 450
 #extension GL_KHR_vulkan_glsl : enable
 
-layout(location = 0) in vec3 fragCol;
 layout(location = 1) in vec2 fragTex;
 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+// Every texture, sized by the renderer to what the device allows
+layout(constant_id = 0) const uint TEXTURE_COUNT = 1;
+layout(set = 1, binding = 0) uniform sampler2D textureSamplers[TEXTURE_COUNT];
+
+// Texture of the mesh being drawn (the same for the whole draw)
+layout(push_constant) uniform PushTexture
+{
+	int texId;
+} pushTexture;
 
 layout(location = 0) out vec4 outputColor; // Final output color (must also have location)
 
 void main()
 {
-	outputColor = texture(textureSampler, fragTex);
+	outputColor = texture(textureSamplers[pushTexture.texId], fragTex);
 }
\ No newline at end of file
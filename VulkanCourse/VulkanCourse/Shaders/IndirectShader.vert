@@ -0,0 +1,24 @@
+#version 450
+
+layout (location = 0) in vec3 pos;
+layout (location = 2) in vec2 tex;
+
+layout (set = 0, binding = 0) uniform UboViewProjection 
+{
+	mat4 view;
+	mat4 projection;
+}uboViewProjection;
+
+// Model matrix of every model (or of each of its instances), the indirect command's first instance is the first entry
+layout (set = 0, binding = 1, std430) readonly buffer ObjectData
+{
+	mat4 models[];
+} objectData;
+
+layout (location = 1) out vec2 fragTex;
+
+void main()
+{
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * objectData.models[gl_InstanceIndex] * vec4(pos, 1.0);
+	fragTex = tex;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450
+
+layout (location = 0) in vec3 pos;
+layout (location = 2) in vec2 tex;
+
+// Per instance transform, relative to the model, from the instance buffer (a mat4 takes 4 locations)
+layout (location = 3) in mat4 instanceModel;
+
+layout (set = 0, binding = 0) uniform UboViewProjection 
+{
+	mat4 view;
+	mat4 projection;
+}uboViewProjection;
+
+layout (set = 0, binding = 1) uniform UboModel
+{
+	mat4 model;
+} uboModel;
+
+layout (location = 1) out vec2 fragTex;
+
+void main()
+{
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * uboModel.model * instanceModel * vec4(pos, 1.0);
+	fragTex = tex;
+}
\ No newline at end of file
@@ -1,7 +1,8 @@
 #version 450
 
+// Model space, or quantized within the model's box which the model matrix undoes (see VertexFormat.h).
+// Colour (location 1) is only there in some vertex layouts, so it isn't read
 layout (location = 0) in vec3 pos;
-layout (location = 1) in vec3 col;
 layout (location = 2) in vec2 tex;
 
 layout (set = 0, binding = 0) uniform UboViewProjection 
@@ -10,17 +11,15 @@ layout (set = 0, binding = 0) uniform UboViewProjection
 	mat4 projection;
 }uboViewProjection;
 
-layout(push_constant) uniform PushModel
+layout (set = 0, binding = 1) uniform UboModel
 {
 	mat4 model;
-} pushModel;
+} uboModel;
 
-layout (location = 0) out vec3 fragCol;
 layout (location = 1) out vec2 fragTex;
 
 void main()
 {
-	gl_Position = uboViewProjection.projection * uboViewProjection.view * pushModel.model * vec4(pos, 1.0);
-	fragCol = col;
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * uboModel.model * vec4(pos, 1.0);
 	fragTex = tex;
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+@echo off
+rem Optional: rebuilds the shader binaries next to their sources with the Vulkan SDK, then validates them.
+rem The binaries are checked in, so the project builds without the SDK. Run this after changing a shader
+rem and commit the .spv files it writes
+cd /d "%~dp0"
+
+if "%VULKAN_SDK%"=="" (
+	echo VULKAN_SDK is not set, skipping shader compilation
+	exit /b 0
+)
+
+set GLSLC="%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.0
+set SPIRV_VAL="%VULKAN_SDK%\Bin\spirv-val.exe" --target-env vulkan1.0
+
+%GLSLC% VertexShader.vert -o VertexShader.vert.spv || exit /b 1
+%SPIRV_VAL% VertexShader.vert.spv || exit /b 1
+%GLSLC% InstanceShader.vert -o InstanceShader.vert.spv || exit /b 1
+%SPIRV_VAL% InstanceShader.vert.spv || exit /b 1
+%GLSLC% IndirectShader.vert -o IndirectShader.vert.spv || exit /b 1
+%SPIRV_VAL% IndirectShader.vert.spv || exit /b 1
+%GLSLC% FragmentShader.frag -o FragmentShader.frag.spv || exit /b 1
+%SPIRV_VAL% FragmentShader.frag.spv || exit /b 1
+%GLSLC% CullShader.comp -o CullShader.comp.spv || exit /b 1
+%SPIRV_VAL% CullShader.comp.spv || exit /b 1
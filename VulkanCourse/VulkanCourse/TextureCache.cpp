@@ -0,0 +1,63 @@
+#include "TextureCache.h"
+
+#include "Utilities.h"
+
+TextureKey TextureCache::MakeKey(const std::string& resolvedPath, const uint8_t* data, const size_t size)
+{
+	TextureKey key;
+	key.resolvedPath = resolvedPath;
+	key.contentHash = HashBytes(data, size);
+
+	return key;
+}
+
+bool TextureCache::Contains(const TextureKey& key) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return textureIds.count(std::make_pair(key.resolvedPath, key.contentHash)) != 0;
+}
+
+int TextureCache::Acquire(const TextureKey& key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto textureId = textureIds.find(std::make_pair(key.resolvedPath, key.contentHash));
+	if (textureId == textureIds.end()) return -1;
+
+	++entries[textureId->second].references;
+	return textureId->second;
+}
+
+void TextureCache::Add(const TextureKey& key, const int textureId)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Entry& entry = entries[textureId];
+	entry.key = std::make_pair(key.resolvedPath, key.contentHash);
+	entry.references = 1;
+
+	textureIds[entry.key] = textureId;
+}
+
+bool TextureCache::Release(const int textureId)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto entry = entries.find(textureId);
+	if (entry == entries.end()) return false;
+
+	if (--entry->second.references > 0) return false;
+
+	// Gone before the texture is destroyed, so loading threads stop finding it
+	textureIds.erase(entry->second.key);
+	entries.erase(entry);
+	return true;
+}
+
+size_t TextureCache::GetTextureCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return entries.size();
+}
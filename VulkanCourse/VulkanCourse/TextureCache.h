@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// Identity of a texture: the file it was actually loaded from and what was in it
+struct TextureKey
+{
+	std::string resolvedPath; // e.g. the converted .ktx2 rather than the image a material names
+	uint64_t contentHash = 0;
+};
+
+// Textures that have been created, so loading the same file again shares the texture instead of uploading a copy.
+// Each user holds a reference, the texture is only destroyed once the last of them has let go.
+// Lookups are safe from loading threads, everything else is done by the render thread.
+class TextureCache
+{
+public:
+	static TextureKey MakeKey(const std::string& resolvedPath, const uint8_t* data, size_t size);
+
+	// Whether there is a texture for the key (it can still be released before it's acquired)
+	bool Contains(const TextureKey& key) const;
+
+	// Id of the texture for the key with one more reference to it, -1 when there is none
+	int Acquire(const TextureKey& key);
+	// A texture that was just created, its creator holds the first reference
+	void Add(const TextureKey& key, int textureId);
+	// Drops one reference, true when that was the last one and the texture should be destroyed
+	bool Release(int textureId);
+
+	size_t GetTextureCount() const;
+
+private:
+	struct Entry
+	{
+		std::pair<std::string, uint64_t> key;
+		uint32_t references = 0;
+	};
+
+	mutable std::mutex mutex;
+	std::map<std::pair<std::string, uint64_t>, int> textureIds;
+	std::map<int, Entry> entries; // by texture id
+};
@@ -0,0 +1,224 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+	const size_t KTX2_HEADER_SIZE = 80; // identifier, header and index, the level index follows
+	const size_t KTX2_LEVEL_SIZE = 24; // byteOffset, byteLength, uncompressedByteLength
+
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const size_t DDS_HEADER_SIZE = 128; // magic and DDS_HEADER
+	const size_t DDS_DX10_HEADER_SIZE = 20;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+
+	uint32_t MakeFourCC(const char a, const char b, const char c, const char d)
+	{
+		return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 |
+			static_cast<uint32_t>(d) << 24;
+	}
+
+	// Both containers are little endian, like everything this runs on
+	uint32_t ReadU32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadU64(const uint8_t* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	// Levels in a full chain down to 1x1
+	uint32_t GetMaxLevelCount(const uint32_t width, const uint32_t height)
+	{
+		uint32_t levels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		{
+			++levels;
+		}
+		return levels;
+	}
+
+	VkFormat GetDxgiFormat(const uint32_t dxgiFormat)
+	{
+		switch (dxgiFormat)
+		{
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK; // DXGI_FORMAT_BC1_UNORM
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK; // DXGI_FORMAT_BC3_UNORM
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK; // DXGI_FORMAT_BC7_UNORM
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+}
+
+bool TextureFile::LoadCompressed(const std::string& fileLocation, DecodedTexture* texture)
+{
+	auto file = std::make_shared<MappedFile>();
+	if (!file->Open(fileLocation)) return false;
+
+	DecodedTexture compressed;
+	const bool valid = ReadKtx2(file->GetData(), file->GetSize(), &compressed) ||
+		ReadDds(file->GetData(), file->GetSize(), &compressed);
+	if (!valid) return false;
+
+	compressed.file = file;
+	compressed.data = file->GetData();
+	*texture = std::move(compressed);
+
+	return true;
+}
+
+uint32_t TextureFile::GetBlockBytes(const VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+VkDeviceSize TextureFile::GetLevelSize(const VkFormat format, const uint32_t width, const uint32_t height)
+{
+	// Partial blocks at the edges still take a whole block
+	const VkDeviceSize blocksWide = (static_cast<VkDeviceSize>(width) + 3) / 4;
+	const VkDeviceSize blocksHigh = (static_cast<VkDeviceSize>(height) + 3) / 4;
+
+	return blocksWide * blocksHigh * GetBlockBytes(format);
+}
+
+bool TextureFile::ReadKtx2(const uint8_t* data, const size_t size, DecodedTexture* texture)
+{
+	if (size < KTX2_HEADER_SIZE || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) return false;
+
+	const VkFormat format = static_cast<VkFormat>(ReadU32(data + 12));
+	const uint32_t width = ReadU32(data + 20);
+	const uint32_t height = ReadU32(data + 24);
+	const uint32_t depth = ReadU32(data + 28);
+	const uint32_t layerCount = ReadU32(data + 32);
+	const uint32_t faceCount = ReadU32(data + 36);
+	const uint32_t levelCount = std::max(ReadU32(data + 40), 1u); // 0 asks for the chain to be generated
+	const uint32_t supercompression = ReadU32(data + 44);
+
+	// Only plain 2D block compressed images, the blocks are copied to the device without any decoding
+	if (GetBlockBytes(format) == 0 || width == 0 || height == 0 || depth != 0 || layerCount > 1 ||
+		faceCount != 1 || supercompression != 0 || levelCount > GetMaxLevelCount(width, height) ||
+		size < KTX2_HEADER_SIZE + KTX2_LEVEL_SIZE * levelCount)
+	{
+		return false;
+	}
+
+	texture->levels.resize(levelCount);
+	texture->size = 0;
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		const uint8_t* levelIndex = data + KTX2_HEADER_SIZE + KTX2_LEVEL_SIZE * i;
+
+		TextureLevel& level = texture->levels[i];
+		level.offset = ReadU64(levelIndex);
+		level.size = ReadU64(levelIndex + 8);
+		level.width = std::max(width >> i, 1u);
+		level.height = std::max(height >> i, 1u);
+
+		if (level.size != GetLevelSize(format, level.width, level.height) || level.offset > size ||
+			level.size > size - level.offset)
+		{
+			return false;
+		}
+
+		texture->size += level.size;
+	}
+
+	texture->format = format;
+	texture->width = static_cast<int>(width);
+	texture->height = static_cast<int>(height);
+
+	return true;
+}
+
+bool TextureFile::ReadDds(const uint8_t* data, const size_t size, DecodedTexture* texture)
+{
+	if (size < DDS_HEADER_SIZE || ReadU32(data) != DDS_MAGIC || ReadU32(data + 4) != 124) return false;
+
+	const uint32_t flags = ReadU32(data + 8);
+	const uint32_t height = ReadU32(data + 12);
+	const uint32_t width = ReadU32(data + 16);
+	const uint32_t levelCount = flags & DDSD_MIPMAPCOUNT ? std::max(ReadU32(data + 28), 1u) : 1;
+	const uint32_t fourCC = ReadU32(data + 84);
+	const uint32_t caps2 = ReadU32(data + 112);
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	size_t dataOffset = DDS_HEADER_SIZE;
+
+	if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+	{
+		format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	}
+	else if (fourCC == MakeFourCC('D', 'X', 'T', '5'))
+	{
+		format = VK_FORMAT_BC3_UNORM_BLOCK;
+	}
+	else if (fourCC == MakeFourCC('D', 'X', '1', '0') && size >= DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+	{
+		const uint8_t* dx10Header = data + DDS_HEADER_SIZE;
+		const uint32_t resourceDimension = ReadU32(dx10Header + 4);
+		const uint32_t arraySize = ReadU32(dx10Header + 12);
+
+		// Texture2D only, no arrays or cube maps
+		if (resourceDimension == 3 && arraySize <= 1)
+		{
+			format = GetDxgiFormat(ReadU32(dx10Header));
+		}
+		dataOffset += DDS_DX10_HEADER_SIZE;
+	}
+
+	if (GetBlockBytes(format) == 0 || width == 0 || height == 0 || caps2 & DDSCAPS2_CUBEMAP ||
+		levelCount > GetMaxLevelCount(width, height))
+	{
+		return false;
+	}
+
+	// Levels are packed one after the other, largest first
+	texture->levels.resize(levelCount);
+	texture->size = 0;
+	VkDeviceSize offset = dataOffset;
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		TextureLevel& level = texture->levels[i];
+		level.offset = offset;
+		level.width = std::max(width >> i, 1u);
+		level.height = std::max(height >> i, 1u);
+		level.size = GetLevelSize(format, level.width, level.height);
+
+		offset += level.size;
+		texture->size += level.size;
+	}
+
+	if (offset > size) return false;
+
+	texture->format = format;
+	texture->width = static_cast<int>(width);
+	texture->height = static_cast<int>(height);
+
+	return true;
+}
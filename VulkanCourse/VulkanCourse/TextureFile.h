@@ -0,0 +1,53 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureCache.h"
+#include "stb_image.h"
+
+// One mip level of a texture, a part of its data
+struct TextureLevel
+{
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// Texture file ready to upload, either pixels decoded by stb_image (4 bytes per texel, RGBA)
+// or a block compressed file mapped as it is, mip chain included.
+// Files that are already in the texture cache aren't read any further, only their key is set.
+struct DecodedTexture
+{
+	TextureKey key;
+	stbi_uc* pixels = nullptr; // freed once uploaded, null for compressed files
+	std::shared_ptr<MappedFile> file; // compressed files only
+	const uint8_t* data = nullptr; // level offsets are from here, into pixels or file
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	int width = 0;
+	int height = 0;
+	VkDeviceSize size = 0; // of every level together
+	std::vector<TextureLevel> levels; // largest first, empty when only the key was set
+};
+
+// Readers for the containers block compressed textures come in (see the TextureConverter project)
+class TextureFile
+{
+public:
+	// KTX2 or DDS file holding BC1, BC3 or BC7 blocks, false when it isn't one or can't be used as it is
+	static bool LoadCompressed(const std::string& fileLocation, DecodedTexture* texture);
+
+	// Bytes per 4x4 block, 0 when the format isn't one of the supported block formats
+	static uint32_t GetBlockBytes(VkFormat format);
+	// Size of one level of a block compressed texture
+	static VkDeviceSize GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+private:
+	static bool ReadKtx2(const uint8_t* data, size_t size, DecodedTexture* texture);
+	static bool ReadDds(const uint8_t* data, size_t size, DecodedTexture* texture);
+};
@@ -0,0 +1,51 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(const uint32_t threadCount)
+{
+	workers.reserve(threadCount);
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	// Let workers finish whatever is already queued, then stop them
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping && tasks.empty()) return;
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		// Exceptions are caught by the packaged task and handed to the task's future
+		task();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run queued tasks in FIFO order
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+	ThreadPool(ThreadPool&& other) = delete;
+	ThreadPool& operator=(ThreadPool&& other) = delete;
+
+	// Queue a task, the returned future gives its result (or rethrows its exception) once it has run
+	template <typename Function>
+	auto Enqueue(Function function) -> std::future<decltype(function())>
+	{
+		using Result = decltype(function());
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+		std::future<Result> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.emplace([task]() { (*task)(); });
+		}
+		taskAvailable.notify_one();
+
+		return result;
+	}
+
+	uint32_t GetThreadCount() const;
+
+private:
+	std::vector<std::thread> workers;
+
+	std::queue<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable taskAvailable;
+	bool stopping = false;
+
+	void WorkerLoop();
+};
@@ -0,0 +1,83 @@
+#include "UniformRingBuffer.h"
+
+#include <stdexcept>
+#include "Utilities.h"
+
+UniformRingBuffer::UniformRingBuffer()
+	: allocator(nullptr), device(nullptr), buffer(VK_NULL_HANDLE), mappedData(nullptr), alignment(1),
+	  frameSize(0), frameCount(0), frameStart(0), head(0)
+{
+}
+
+UniformRingBuffer::UniformRingBuffer(DeviceMemoryAllocator* newAllocator, VkDevice newDevice,
+                                     const VkDeviceSize minOffsetAlignment, const VkDeviceSize newFrameSize,
+                                     const uint32_t newFrameCount)
+	: allocator(newAllocator), device(newDevice), buffer(VK_NULL_HANDLE), mappedData(nullptr),
+	  alignment(minOffsetAlignment > 0 ? minOffsetAlignment : 1), frameSize(0), frameCount(newFrameCount),
+	  frameStart(0), head(0)
+{
+	// Regions have to start on an aligned offset too
+	frameSize = AlignUp(newFrameSize);
+
+	CreateBuffer(allocator, device, frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, &bufferMemory);
+
+	// Allocator keeps host visible memory mapped (host coherent, so no flushes either)
+	mappedData = static_cast<uint8_t*>(bufferMemory.mappedData);
+}
+
+void UniformRingBuffer::BeginFrame(const uint32_t frame)
+{
+	frameStart = frameSize * (frame % frameCount);
+	head = 0;
+}
+
+UniformAllocation UniformRingBuffer::Allocate(const VkDeviceSize size)
+{
+	const VkDeviceSize alignedSize = AlignUp(size);
+
+	if (head + alignedSize > frameSize)
+	{
+		throw std::runtime_error("Uniform ring buffer frame region is full");
+	}
+
+	UniformAllocation allocation;
+	allocation.offset = static_cast<uint32_t>(frameStart + head);
+	allocation.data = mappedData + frameStart + head;
+
+	head += alignedSize;
+
+	return allocation;
+}
+
+VkBuffer UniformRingBuffer::GetBuffer() const
+{
+	return buffer;
+}
+
+VkDeviceSize UniformRingBuffer::GetFrameSize() const
+{
+	return frameSize;
+}
+
+VkDeviceSize UniformRingBuffer::GetFrameUsage() const
+{
+	return head;
+}
+
+void UniformRingBuffer::DestroyBuffer()
+{
+	if (buffer == VK_NULL_HANDLE) return;
+
+	vkDestroyBuffer(device, buffer, nullptr);
+	allocator->Free(bufferMemory);
+
+	buffer = VK_NULL_HANDLE;
+	bufferMemory = MemoryAllocation();
+	mappedData = nullptr;
+}
+
+VkDeviceSize UniformRingBuffer::AlignUp(const VkDeviceSize size) const
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "DeviceMemoryAllocator.h"
+
+// Sub-range of the ring handed out for one frame, bound with its offset as a dynamic offset
+struct UniformAllocation
+{
+	uint32_t offset = 0; // offset from the start of the buffer
+	void* data = nullptr; // mapped pointer to write the data through
+};
+
+// One large, persistently mapped uniform buffer split into a region per frame.
+// Each frame allocates linearly through its own region, aligned for use as dynamic uniform buffer offsets.
+class UniformRingBuffer
+{
+public:
+	UniformRingBuffer();
+	UniformRingBuffer(DeviceMemoryAllocator* newAllocator, VkDevice newDevice, VkDeviceSize minOffsetAlignment,
+	                  VkDeviceSize newFrameSize, uint32_t newFrameCount);
+
+	// Start allocating from the start of the frame's region (the frame must no longer be in use by the GPU)
+	void BeginFrame(uint32_t frame);
+	UniformAllocation Allocate(VkDeviceSize size);
+
+	template <typename T>
+	T* Allocate(uint32_t* offset)
+	{
+		const UniformAllocation allocation = Allocate(sizeof(T));
+		*offset = allocation.offset;
+		return static_cast<T*>(allocation.data);
+	}
+
+	VkBuffer GetBuffer() const;
+	VkDeviceSize GetFrameSize() const;
+	VkDeviceSize GetFrameUsage() const; // bytes allocated so far in the current frame
+
+	void DestroyBuffer();
+
+private:
+	DeviceMemoryAllocator* allocator;
+	VkDevice device;
+	VkBuffer buffer;
+	MemoryAllocation bufferMemory;
+	uint8_t* mappedData;
+
+	VkDeviceSize alignment;
+	VkDeviceSize frameSize;
+	uint32_t frameCount;
+
+	VkDeviceSize frameStart; // start of the current frame's region
+	VkDeviceSize head; // next free byte in the current frame's region
+
+	VkDeviceSize AlignUp(VkDeviceSize size) const;
+};
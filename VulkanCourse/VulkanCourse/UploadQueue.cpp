@@ -0,0 +1,391 @@
+#include "UploadQueue.h"
+
+UploadQueue::UploadQueue()
+	: allocator(nullptr), device(nullptr), transferQueue(nullptr), graphicsQueue(nullptr), transferFamily(0),
+	  graphicsFamily(0), transferCommandPool(VK_NULL_HANDLE), acquireCommandPool(VK_NULL_HANDLE),
+	  ringBuffer(VK_NULL_HANDLE), ringHead(0), ringTail(0), acquireStages(0), nextTicket(1), completedTicket(0)
+{
+}
+
+UploadQueue::UploadQueue(DeviceMemoryAllocator* newAllocator, VkDevice newDevice,
+                         const QueueFamilyIndices& queueFamilies, VkQueue newTransferQueue, VkQueue newGraphicsQueue)
+	: allocator(newAllocator), device(newDevice), transferQueue(newTransferQueue), graphicsQueue(newGraphicsQueue),
+	  transferFamily(static_cast<uint32_t>(queueFamilies.transferFamily)),
+	  graphicsFamily(static_cast<uint32_t>(queueFamilies.graphicsFamily)), transferCommandPool(VK_NULL_HANDLE),
+	  acquireCommandPool(VK_NULL_HANDLE), ringBuffer(VK_NULL_HANDLE), ringHead(0), ringTail(0), acquireStages(0),
+	  nextTicket(1), completedTicket(0)
+{
+	// Upload command buffers are recorded once and freed straight after they've run
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = transferFamily;
+
+	VK_ERROR(vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool),
+	         "Failed to create transfer command pool");
+
+	if (IsDedicated())
+	{
+		poolInfo.queueFamilyIndex = graphicsFamily;
+		VK_ERROR(vkCreateCommandPool(device, &poolInfo, nullptr, &acquireCommandPool),
+		         "Failed to create acquire command pool");
+	}
+
+	// Staging ring stays mapped for its whole lifetime, uploads write straight into it
+	CreateBuffer(allocator, device, STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ringBuffer,
+	             &ringBufferMemory);
+}
+
+bool UploadQueue::IsDedicated() const
+{
+	return transferFamily != graphicsFamily;
+}
+
+StagingAllocation UploadQueue::AllocateStaging(const VkDeviceSize size, const VkDeviceSize alignment)
+{
+	StagingAllocation allocation;
+
+	// Too big for the ring, so it gets a buffer of its own that is destroyed with its batch
+	if (size > STAGING_RING_SIZE)
+	{
+		StagingBuffer staging;
+		CreateBuffer(allocator, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.buffer,
+		             &staging.memory);
+		openBatch.stagingBuffers.push_back(staging);
+
+		allocation.buffer = staging.buffer;
+		allocation.data = staging.memory.mappedData;
+		return allocation;
+	}
+
+	VkDeviceSize start = 0;
+	while (true)
+	{
+		start = (ringHead + alignment - 1) / alignment * alignment;
+
+		// Allocations never wrap around the end of the buffer, skip to the start instead
+		if (start % STAGING_RING_SIZE + size > STAGING_RING_SIZE)
+		{
+			start = (start / STAGING_RING_SIZE + 1) * STAGING_RING_SIZE;
+		}
+
+		if (start + size - ringTail <= STAGING_RING_SIZE) break;
+
+		// Ring is full: submit what is waiting to use it and wait for the oldest batch to give its space back
+		if (pendingBatches.empty())
+		{
+			Flush();
+		}
+
+		if (pendingBatches.empty())
+		{
+			// Space is taken by data that hasn't had its copy recorded yet, nothing will give it back
+			if (ringHead != ringTail)
+			{
+				VK_ERROR(-1, "Staging ring is full of uploads that haven't been recorded");
+			}
+
+			// Nothing reads the ring any more, so start again from the beginning of the buffer
+			ringHead = ringTail = (ringHead + STAGING_RING_SIZE - 1) / STAGING_RING_SIZE * STAGING_RING_SIZE;
+			continue;
+		}
+
+		Wait(pendingBatches.front().ticket);
+	}
+
+	ringHead = start + size;
+
+	allocation.buffer = ringBuffer;
+	allocation.offset = start % STAGING_RING_SIZE;
+	allocation.data = static_cast<uint8_t*>(ringBufferMemory.mappedData) + allocation.offset;
+	return allocation;
+}
+
+VkCommandBuffer UploadQueue::Record()
+{
+	if (openBatch.transferCommandBuffer == VK_NULL_HANDLE)
+	{
+		openBatch.ticket = nextTicket;
+		openBatch.transferCommandBuffer = BeginCommandBuffer(device, transferCommandPool);
+	}
+
+	return openBatch.transferCommandBuffer;
+}
+
+void UploadQueue::ReleaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, const VkDeviceSize offset,
+                                const VkDeviceSize size, const VkPipelineStageFlags dstStage,
+                                const VkAccessFlags dstAccess)
+{
+	VkBufferMemoryBarrier bufferMemoryBarrier = {};
+	bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferMemoryBarrier.dstAccessMask = dstAccess;
+	bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferMemoryBarrier.buffer = buffer;
+	bufferMemoryBarrier.offset = offset;
+	bufferMemoryBarrier.size = size;
+
+	if (!IsDedicated())
+	{
+		// Same queue, so a plain barrier makes the copy visible to the stages that read it
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1,
+		                     &bufferMemoryBarrier, 0, nullptr);
+		return;
+	}
+
+	// Release half of the ownership transfer (its destination access is done by the acquire)
+	bufferMemoryBarrier.dstAccessMask = 0;
+	bufferMemoryBarrier.srcQueueFamilyIndex = transferFamily;
+	bufferMemoryBarrier.dstQueueFamilyIndex = graphicsFamily;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+	                     nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+	// Acquire half, with the same families and range, recorded on the graphics queue when the batch is flushed
+	bufferMemoryBarrier.srcAccessMask = 0;
+	bufferMemoryBarrier.dstAccessMask = dstAccess;
+	bufferAcquires.push_back(bufferMemoryBarrier);
+	acquireStages |= dstStage;
+}
+
+void UploadQueue::ReleaseImage(VkCommandBuffer commandBuffer, VkImage image, const VkImageLayout oldLayout,
+                               const VkImageLayout newLayout, const VkPipelineStageFlags dstStage,
+                               const VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = dstAccess;
+	imageMemoryBarrier.oldLayout = oldLayout;
+	imageMemoryBarrier.newLayout = newLayout;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+	if (!IsDedicated())
+	{
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1,
+		                     &imageMemoryBarrier);
+		return;
+	}
+
+	// The layout transition happens once, between the release and the acquire (both must name the same layouts)
+	imageMemoryBarrier.dstAccessMask = 0;
+	imageMemoryBarrier.srcQueueFamilyIndex = transferFamily;
+	imageMemoryBarrier.dstQueueFamilyIndex = graphicsFamily;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+	                     nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	imageMemoryBarrier.srcAccessMask = 0;
+	imageMemoryBarrier.dstAccessMask = dstAccess;
+	imageAcquires.push_back(imageMemoryBarrier);
+	acquireStages |= dstStage;
+}
+
+void UploadQueue::ReleaseImageWithMipmaps(VkCommandBuffer commandBuffer, VkImage image, const uint32_t width,
+                                          const uint32_t height, const uint32_t mipLevels,
+                                          const VkPipelineStageFlags dstStage, const VkAccessFlags dstAccess)
+{
+	if (!IsDedicated())
+	{
+		GenerateMipmaps(commandBuffer, image, width, height, mipLevels, dstStage, dstAccess);
+		return;
+	}
+
+	// Handed over still as a copy destination, the blits read and write it next
+	ReleaseImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	acquireMipmaps.push_back({image, width, height, mipLevels, dstStage, dstAccess});
+}
+
+uint64_t UploadQueue::GetRecordingTicket() const
+{
+	// Nothing is open, so everything recorded so far is done once the last submitted batch is
+	if (openBatch.transferCommandBuffer == VK_NULL_HANDLE) return nextTicket - 1;
+
+	return nextTicket;
+}
+
+uint64_t UploadQueue::Flush()
+{
+	// Nothing recorded, so the last submitted batch is the one to wait for
+	if (openBatch.transferCommandBuffer == VK_NULL_HANDLE) return nextTicket - 1;
+
+	Batch batch = openBatch;
+	batch.ringEnd = ringHead;
+	openBatch = Batch();
+	++nextTicket;
+
+	VK_ERROR(vkEndCommandBuffer(batch.transferCommandBuffer), "Failed to stop recording upload command buffer");
+
+	batch.transferFence = CreateFence();
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+	// The graphics queue waits for the copies on the GPU, the CPU doesn't have to
+	const bool needsAcquire = !bufferAcquires.empty() || !imageAcquires.empty();
+	if (needsAcquire)
+	{
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		VK_ERROR(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &batch.transferFinished),
+		         "Failed to create upload semaphore");
+
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &batch.transferFinished;
+	}
+
+	VK_ERROR(vkQueueSubmit(transferQueue, 1, &submitInfo, batch.transferFence),
+	         "Failed to submit upload command buffer");
+
+	if (needsAcquire)
+	{
+		SubmitAcquire(batch);
+	}
+
+	pendingBatches.push_back(batch);
+
+	return batch.ticket;
+}
+
+VkFence UploadQueue::CreateFence() const
+{
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	VK_ERROR(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence), "Failed to create upload fence");
+
+	return fence;
+}
+
+void UploadQueue::SubmitAcquire(Batch& batch)
+{
+	batch.acquireCommandBuffer = BeginCommandBuffer(device, acquireCommandPool);
+
+	vkCmdPipelineBarrier(batch.acquireCommandBuffer, acquireStages, acquireStages, 0, 0, nullptr,
+	                     static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+	                     static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+
+	for (const auto& mipmapImage : acquireMipmaps)
+	{
+		GenerateMipmaps(batch.acquireCommandBuffer, mipmapImage.image, mipmapImage.width, mipmapImage.height,
+		                mipmapImage.mipLevels, mipmapImage.dstStage, mipmapImage.dstAccess);
+	}
+
+	VK_ERROR(vkEndCommandBuffer(batch.acquireCommandBuffer), "Failed to stop recording acquire command buffer");
+
+	batch.acquireFence = CreateFence();
+
+	// Frames submitted after this run after the acquire, so they see the uploaded data
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &batch.transferFinished;
+	submitInfo.pWaitDstStageMask = &acquireStages;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+
+	VK_ERROR(vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.acquireFence),
+	         "Failed to submit acquire command buffer");
+
+	bufferAcquires.clear();
+	imageAcquires.clear();
+	acquireMipmaps.clear();
+	acquireStages = 0;
+}
+
+bool UploadQueue::IsComplete(const uint64_t ticket)
+{
+	CollectFinished();
+	return ticket <= completedTicket;
+}
+
+void UploadQueue::Wait(const uint64_t ticket)
+{
+	if (ticket >= nextTicket)
+	{
+		Flush();
+	}
+
+	for (const auto& batch : pendingBatches)
+	{
+		if (batch.ticket > ticket) break;
+
+		VK_ERROR(vkWaitForFences(device, 1, &batch.transferFence, VK_TRUE, UINT64_MAX),
+		         "Failed to wait for upload fence");
+		if (batch.acquireFence != VK_NULL_HANDLE)
+		{
+			VK_ERROR(vkWaitForFences(device, 1, &batch.acquireFence, VK_TRUE, UINT64_MAX),
+			         "Failed to wait for acquire fence");
+		}
+	}
+
+	CollectFinished();
+}
+
+void UploadQueue::WaitAll()
+{
+	Wait(Flush());
+}
+
+bool UploadQueue::IsBatchFinished(const Batch& batch) const
+{
+	if (vkGetFenceStatus(device, batch.transferFence) != VK_SUCCESS) return false;
+	return batch.acquireFence == VK_NULL_HANDLE || vkGetFenceStatus(device, batch.acquireFence) == VK_SUCCESS;
+}
+
+void UploadQueue::CollectFinished()
+{
+	// Batches finish in the order they were submitted
+	while (!pendingBatches.empty() && IsBatchFinished(pendingBatches.front()))
+	{
+		completedTicket = pendingBatches.front().ticket;
+		ringTail = pendingBatches.front().ringEnd;
+		DestroyBatch(pendingBatches.front());
+		pendingBatches.pop_front();
+	}
+}
+
+void UploadQueue::DestroyBatch(Batch& batch)
+{
+	for (const auto& staging : batch.stagingBuffers)
+	{
+		vkDestroyBuffer(device, staging.buffer, nullptr);
+		allocator->Free(staging.memory);
+	}
+
+	vkFreeCommandBuffers(device, transferCommandPool, 1, &batch.transferCommandBuffer);
+	vkDestroyFence(device, batch.transferFence, nullptr);
+
+	if (batch.acquireCommandBuffer != VK_NULL_HANDLE)
+	{
+		vkFreeCommandBuffers(device, acquireCommandPool, 1, &batch.acquireCommandBuffer);
+		vkDestroySemaphore(device, batch.transferFinished, nullptr);
+		vkDestroyFence(device, batch.acquireFence, nullptr);
+	}
+}
+
+void UploadQueue::DestroyUploadQueue()
+{
+	if (device == nullptr) return;
+
+	WaitAll();
+
+	vkDestroyBuffer(device, ringBuffer, nullptr);
+	allocator->Free(ringBufferMemory);
+
+	vkDestroyCommandPool(device, acquireCommandPool, nullptr);
+	vkDestroyCommandPool(device, transferCommandPool, nullptr);
+}
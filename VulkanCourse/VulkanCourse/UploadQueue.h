@@ -0,0 +1,140 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <deque>
+#include <vector>
+
+#include "Utilities.h"
+
+// Part of a staging buffer an upload's source data is written into
+struct StagingAllocation
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0; // copy from here
+	void* data = nullptr; // mapped pointer to offset
+};
+
+// Copies staged data to the device on the transfer queue family, and hands the results over to the graphics family.
+// When the device has no separate transfer family everything runs on the graphics queue instead.
+// Uploads are batched: everything recorded until the next Flush goes into one command buffer and one submission.
+// Source data is staged in one persistently mapped ring buffer, whose space is reused once the batch has finished.
+class UploadQueue
+{
+public:
+	static const VkDeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024;
+
+	UploadQueue();
+	UploadQueue(DeviceMemoryAllocator* newAllocator, VkDevice newDevice, const QueueFamilyIndices& queueFamilies,
+	            VkQueue newTransferQueue, VkQueue newGraphicsQueue);
+
+	// Transfer and graphics work run on different queue families
+	bool IsDedicated() const;
+
+	// Space to write an upload's source data into, valid until the batch it's copied in has finished.
+	// Call before recording the upload's commands, older batches may be flushed and waited on to make room.
+	StagingAllocation AllocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	// - Recording (into the open batch, started if there isn't one)
+	VkCommandBuffer Record();
+
+	// Make data the commands wrote visible to (and owned by) the graphics family at the given stages
+	void ReleaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+	                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	void ReleaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	// Same for an image whose first level was written and whose other levels are blitted down from it.
+	// Blits need a graphics queue, so with a dedicated transfer family they're recorded after the acquire.
+	// Every level has to be in TRANSFER_DST_OPTIMAL, and ends up in SHADER_READ_ONLY_OPTIMAL.
+	void ReleaseImageWithMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height,
+	                             uint32_t mipLevels, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	// Ticket that completes once everything recorded so far has been uploaded: the open batch's, or the last
+	// submitted one's when nothing is open (a later batch may never be submitted)
+	uint64_t GetRecordingTicket() const;
+
+	// - Submission
+	// Submit the open batch (nothing is waited on) and return its ticket.
+	// Ownership is acquired by a graphics submission queued behind the copies, ahead of any later frame.
+	uint64_t Flush();
+
+	bool IsComplete(uint64_t ticket);
+	void Wait(uint64_t ticket); // flushes first if the ticket is the open batch
+	void WaitAll();
+
+	// Free batches that have finished, called once per frame
+	void CollectFinished();
+
+	void DestroyUploadQueue();
+
+private:
+	// Buffer made for data too big for the ring
+	struct StagingBuffer
+	{
+		VkBuffer buffer;
+		MemoryAllocation memory;
+	};
+
+	// Image whose levels are generated on the graphics queue once it's been acquired
+	struct MipmapImage
+	{
+		VkImage image;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		VkPipelineStageFlags dstStage;
+		VkAccessFlags dstAccess;
+	};
+
+	// One submission of the transfer queue, and the graphics side of its ownership transfers
+	struct Batch
+	{
+		uint64_t ticket = 0;
+
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkFence transferFence = VK_NULL_HANDLE;
+
+		VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+		VkSemaphore transferFinished = VK_NULL_HANDLE;
+		VkFence acquireFence = VK_NULL_HANDLE;
+
+		VkDeviceSize ringEnd = 0; // ring space up to here is free once the batch has finished
+		std::vector<StagingBuffer> stagingBuffers;
+	};
+
+	DeviceMemoryAllocator* allocator;
+	VkDevice device;
+
+	VkQueue transferQueue;
+	VkQueue graphicsQueue;
+	uint32_t transferFamily;
+	uint32_t graphicsFamily;
+
+	VkCommandPool transferCommandPool;
+	VkCommandPool acquireCommandPool; // graphics family, only used for acquire barriers
+
+	// Ring positions only ever grow, the position in the buffer is them modulo the ring size
+	VkBuffer ringBuffer;
+	MemoryAllocation ringBufferMemory;
+	VkDeviceSize ringHead; // next free byte
+	VkDeviceSize ringTail; // oldest byte still read by a batch
+
+	// Batch being recorded (no command buffer when there isn't one)
+	Batch openBatch;
+
+	// Acquire barriers matching the releases recorded into the open batch
+	std::vector<VkBufferMemoryBarrier> bufferAcquires;
+	std::vector<VkImageMemoryBarrier> imageAcquires;
+	VkPipelineStageFlags acquireStages;
+	std::vector<MipmapImage> acquireMipmaps;
+
+	// Submitted batches, oldest first
+	std::deque<Batch> pendingBatches;
+	uint64_t nextTicket;
+	uint64_t completedTicket; // every batch up to and including this one has finished
+
+	VkFence CreateFence() const;
+	void SubmitAcquire(Batch& batch);
+	bool IsBatchFinished(const Batch& batch) const;
+	void DestroyBatch(Batch& batch);
+};
@@ -1,13 +1,21 @@
 #pragma once
 
 #include <fstream>
+#include <vector>
 #include <glm/glm.hpp>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "DeviceMemoryAllocator.h"
+#include "VertexFormat.h"
+
 const int MAX_FRAME_DRAWS = 2;
 const int MAX_OBJECTS = 20;
+const int MAX_TEXTURES = 1024; // size of the texture array, lowered to the device's descriptor limits
+const int MAX_INDIRECT_DRAWS = 16384; // meshes the indirect draw path can draw in one frame
+const int MAX_INSTANCES = 16384; // instances added to models, over all models
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 64 * 1024; // bytes of per-object uniform data each frame can allocate
 
 constexpr void VK_ERROR(const int result, const char* message)
 {
@@ -15,18 +23,12 @@ constexpr void VK_ERROR(const int result, const char* message)
 		throw std::runtime_error(message);
 }
 
-struct Vertex
-{
-	glm::vec3 pos; // Vertex Position (x,y,z)
-	glm::vec3 col; // Vertex Color (r,g,b)
-	glm::vec2 tex; // texture coords (u,v)
-};
-
 // Indices (locations) of queue Families (if they exist at all)
 struct QueueFamilyIndices
 {
 	int graphicsFamily = -1; // Location on the Graphics Queue Family
 	int presentationFamily = -1; // Location of Presentation Queue Family
+	int transferFamily = -1; // Location of the family uploads are copied on (the graphics family if there's no other)
 
 	// check if queue families are valid
 	bool IsValid() const
@@ -48,6 +50,13 @@ struct SwapChainImage
 	VkImageView imageView;
 };
 
+// Settings for rendering into offscreen images when there is no window or surface to present to
+struct HeadlessSettings
+{
+	VkExtent2D extent = {1280, 720}; // size of each offscreen render target
+	uint32_t frameCount = MAX_FRAME_DRAWS; // number of offscreen render targets to rotate through
+};
+
 static std::vector<char> ReadFile(const std::string& fileName)
 {
 	// open stream from given file
@@ -76,6 +85,18 @@ static std::vector<char> ReadFile(const std::string& fileName)
 	return fileBuffer;
 }
 
+// FNV-1a, fast and good enough to notice a changed file
+static uint64_t HashBytes(const uint8_t* data, const size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
 static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physicalDevice, const uint32_t allowedTypes,
                                     VkMemoryPropertyFlags properties)
 {
@@ -97,9 +118,9 @@ static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physicalDevice, const uint3
 	return UINT32_MAX;
 }
 
-static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize,
+static void CreateBuffer(DeviceMemoryAllocator* allocator, VkDevice device, VkDeviceSize bufferSize,
                          VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer,
-                         VkDeviceMemory* bufferMemory)
+                         MemoryAllocation* bufferMemory)
 {
 	// Information to create a buffer (doesn't include assigning memory)
 	VkBufferCreateInfo bufferInfo = {};
@@ -114,19 +135,12 @@ static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 	VkMemoryRequirements memoryRequirements;
 	vkGetBufferMemoryRequirements(device, *buffer, &memoryRequirements);
 
-	// Allocate Memory To Buffer
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = FindMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits,
-	                                                         bufferProperties);
-
-	// Allocate memory to VkDeviceMemory
-	VK_ERROR(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, bufferMemory),
-	         "Failed to allocate vertex buffer memory");
+	// Sub-allocate memory for the buffer from one of the allocator's blocks
+	*bufferMemory = allocator->Allocate(memoryRequirements, bufferProperties);
 
 	// Allocate memory to given vertex buffer
-	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
+	VK_ERROR(vkBindBufferMemory(device, *buffer, bufferMemory->memory, bufferMemory->offset),
+	         "Failed to bind buffer memory");
 }
 
 static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool commandPool)
@@ -156,112 +170,116 @@ static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool command
 	return commandBuffer;
 }
 
-static void EndAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue,
-                                      VkCommandBuffer commandBuffer)
+static void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout,
+                                  VkImageLayout newLayout)
 {
-	// end recording commands
-	vkEndCommandBuffer(commandBuffer);
-
-	// Queue submission information
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.oldLayout = oldLayout;
+	imageMemoryBarrier.newLayout = newLayout;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS; // every mip level
+	imageMemoryBarrier.subresourceRange.layerCount = 1;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+
+	VkPipelineStageFlags srcStage{};
+	VkPipelineStageFlags dstStage{};
+
+	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	{
+		// memory access stage transition must happen after
+		imageMemoryBarrier.srcAccessMask = 0; // in this case the first stage of the pipeline
 
-	// submit transfer command to transfer queue and wait until it finished
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
+		// access must happen before
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		// the transfer write from the copy image to buffer method
 
-	// Free temporary command buffer back to pool
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-static void CopyBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer,
-                       VkBuffer dstBuffer, VkDeviceSize bufferSize)
-{
-	const VkCommandBuffer transferCommandBuffer = BeginCommandBuffer(device, transferCommandPool);
-	{
-		// Region of data to copy from and to
-		VkBufferCopy bufferCopyRegion = {};
-		bufferCopyRegion.srcOffset = 0;
-		bufferCopyRegion.dstOffset = 0;
-		bufferCopyRegion.size = bufferSize;
-
-		// Command to copy src buffer to dst buffer
-		vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 	}
-	EndAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
-}
-
-static void CopyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool,
-                            VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height)
-{
-	const VkCommandBuffer transferCommandBuffer = BeginCommandBuffer(device, transferCommandPool);
+	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	{
-		VkBufferImageCopy imageRegion = {};
-		imageRegion.bufferOffset = 0;
-		imageRegion.bufferRowLength = 0;
-		imageRegion.bufferImageHeight = 0;
-		imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageRegion.imageSubresource.mipLevel = 0;
-		imageRegion.imageSubresource.baseArrayLayer = 0;
-		imageRegion.imageSubresource.layerCount = 1;
-		imageRegion.imageOffset = {0, 0, 0};
-		imageRegion.imageExtent = {width, height, 1};
-
-		vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-		                       &imageRegion);
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		
+		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
-	EndAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
+
+	vkCmdPipelineBarrier(commandBuffer,
+		srcStage, dstStage, 
+		0, 0, nullptr, 0, nullptr, 
+		1, &imageMemoryBarrier
+	);
 }
 
-static void TransitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image,
-                                  VkImageLayout oldLayout, VkImageLayout newLayout)
+// Fill every level of an image by halving the one above it with linear blits (needs a graphics queue).
+// All levels start in TRANSFER_DST_OPTIMAL with level 0 written, and end up SHADER_READ_ONLY_OPTIMAL.
+static void GenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height,
+                            uint32_t mipLevels, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
 {
-	const VkCommandBuffer commandBuffer = BeginCommandBuffer(device, commandPool);
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+	int32_t levelWidth = static_cast<int32_t>(width);
+	int32_t levelHeight = static_cast<int32_t>(height);
+
+	for (uint32_t level = 1; level < mipLevels; ++level)
 	{
-		VkImageMemoryBarrier imageMemoryBarrier = {};
-		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageMemoryBarrier.oldLayout = oldLayout;
-		imageMemoryBarrier.newLayout = newLayout;
-		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		imageMemoryBarrier.image = image;
-		imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-		imageMemoryBarrier.subresourceRange.levelCount = 1;
-		imageMemoryBarrier.subresourceRange.layerCount = 1;
-		imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-
-		VkPipelineStageFlags srcStage{};
-		VkPipelineStageFlags dstStage{};
-
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-		{
-			// memory access stage transition must happen after
-			imageMemoryBarrier.srcAccessMask = 0; // in this case the first stage of the pipeline
-
-			// access must happen before
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			// the transfer write from the copy image to buffer method
-
-			srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-		{
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			
-			srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-
-		vkCmdPipelineBarrier(commandBuffer,
-			srcStage, dstStage, 
-			0, 0, nullptr, 0, nullptr, 
-			1, &imageMemoryBarrier
-		);
+		// Level above has been written, read from it
+		imageMemoryBarrier.subresourceRange.baseMipLevel = level - 1;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+		                     nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+		const int32_t nextWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		const int32_t nextHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1] = {levelWidth, levelHeight, 1};
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+
+		vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+		               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		// Done with the level above, it's only sampled from now on
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemoryBarrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1,
+		                     &imageMemoryBarrier);
+
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
 	}
-	EndAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	// Last level was only ever written
+	imageMemoryBarrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1,
+	                     &imageMemoryBarrier);
 }
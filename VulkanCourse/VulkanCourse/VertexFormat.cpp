@@ -0,0 +1,77 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+	Unorm16x4 PackPosition(const glm::vec3 position, const VertexQuantization& quantization)
+	{
+		// Rounding can push vertices on the box's faces just outside it, so they're clamped back in
+		const glm::vec3 quantized = glm::clamp(quantization.Quantize(position), 0.0f, 1.0f);
+
+		return {{glm::packUnorm1x16(quantized.x), glm::packUnorm1x16(quantized.y), glm::packUnorm1x16(quantized.z), 0}};
+	}
+
+	Half2 PackTex(const glm::vec2 tex)
+	{
+		return {{glm::packHalf1x16(tex.x), glm::packHalf1x16(tex.y)}};
+	}
+
+	Unorm8x4 PackColor(const glm::vec3 color)
+	{
+		const glm::vec3 clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+
+		return {{static_cast<uint8_t>(clamped.r), static_cast<uint8_t>(clamped.g), static_cast<uint8_t>(clamped.b), 255}};
+	}
+}
+
+VertexQuantization VertexQuantization::FromBounds(const glm::vec3 boundsMin, const glm::vec3 boundsMax)
+{
+	VertexQuantization quantization;
+	quantization.offset = boundsMin;
+
+	// A flat box still needs a non zero size to divide by
+	const glm::vec3 size = boundsMax - boundsMin;
+	for (glm::length_t i = 0; i < 3; ++i)
+	{
+		quantization.scale[i] = size[i] > 0.0f ? size[i] : 1.0f;
+	}
+
+	return quantization;
+}
+
+glm::vec3 VertexQuantization::Quantize(const glm::vec3 position) const
+{
+	return (position - offset) / scale;
+}
+
+glm::mat4 VertexQuantization::GetDequantizeTransform() const
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), offset), scale);
+}
+
+Vertex Vertex::Pack(const Vertex& vertex, const VertexQuantization& /*quantization*/)
+{
+	return vertex;
+}
+
+QuantizedVertex QuantizedVertex::Pack(const Vertex& vertex, const VertexQuantization& quantization)
+{
+	QuantizedVertex packed;
+	packed.pos = PackPosition(vertex.pos, quantization);
+	packed.tex = PackTex(vertex.tex);
+
+	return packed;
+}
+
+QuantizedColorVertex QuantizedColorVertex::Pack(const Vertex& vertex, const VertexQuantization& quantization)
+{
+	QuantizedColorVertex packed;
+	packed.pos = PackPosition(vertex.pos, quantization);
+	packed.tex = PackTex(vertex.tex);
+	packed.col = PackColor(vertex.col);
+
+	return packed;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Attribute types of the packed layouts (little endian, like everything this runs on)
+struct Unorm16x4
+{
+	uint16_t values[4];
+};
+
+struct Half2
+{
+	uint16_t values[2];
+};
+
+struct Unorm8x4
+{
+	uint8_t values[4];
+};
+
+// Format each attribute type is read as
+template <typename T>
+struct VertexAttributeFormat;
+
+template <>
+struct VertexAttributeFormat<glm::vec2>
+{
+	static constexpr VkFormat FORMAT = VK_FORMAT_R32G32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<glm::vec3>
+{
+	static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<Unorm16x4>
+{
+	static constexpr VkFormat FORMAT = VK_FORMAT_R16G16B16A16_UNORM;
+};
+
+template <>
+struct VertexAttributeFormat<Half2>
+{
+	static constexpr VkFormat FORMAT = VK_FORMAT_R16G16_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<Unorm8x4>
+{
+	static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+};
+
+// Attribute of binding 0 at a shader location, its format follows from the member's type
+template <typename T>
+constexpr VkVertexInputAttributeDescription MakeVertexAttribute(const uint32_t location, const size_t offset)
+{
+	return {location, 0, VertexAttributeFormat<T>::FORMAT, static_cast<uint32_t>(offset)};
+}
+
+// Box a model's positions are quantized within. Its meshes share one, so the model's matrix undoes it for all of them
+struct VertexQuantization
+{
+	glm::vec3 offset = glm::vec3(0.0f); // where 0 ends up
+	glm::vec3 scale = glm::vec3(1.0f); // size of the box on each axis
+
+	static VertexQuantization FromBounds(glm::vec3 boundsMin, glm::vec3 boundsMax);
+	// Box around every one of a model's meshes (anything with a boundsMin and boundsMax)
+	template <typename MeshType>
+	static VertexQuantization FromMeshBounds(const std::vector<MeshType>& meshes);
+
+	glm::vec3 Quantize(glm::vec3 position) const; // model space into the box (0 to 1 inside it)
+	glm::mat4 GetDequantizeTransform() const; // the other way, applied before the model matrix
+};
+
+template <typename MeshType>
+VertexQuantization VertexQuantization::FromMeshBounds(const std::vector<MeshType>& meshes)
+{
+	if (meshes.empty()) return VertexQuantization();
+
+	glm::vec3 boundsMin = meshes.front().boundsMin;
+	glm::vec3 boundsMax = meshes.front().boundsMax;
+	for (const auto& mesh : meshes)
+	{
+		boundsMin = glm::min(boundsMin, mesh.boundsMin);
+		boundsMax = glm::max(boundsMax, mesh.boundsMax);
+	}
+
+	return FromBounds(boundsMin, boundsMax);
+}
+
+// Shader locations: 0 position, 1 colour, 2 texture coords
+
+// Vertex as it's converted and cooked, and uploaded as it is by the full precision layout (32 bytes)
+struct Vertex
+{
+	glm::vec3 pos; // Vertex Position (x,y,z)
+	glm::vec3 col; // Vertex Color (r,g,b)
+	glm::vec2 tex; // texture coords (u,v)
+
+	static constexpr bool QUANTIZED = false;
+
+	static constexpr std::array<VkVertexInputAttributeDescription, 3> GetAttributes()
+	{
+		return {{
+			MakeVertexAttribute<decltype(Vertex::pos)>(0, offsetof(Vertex, pos)),
+			MakeVertexAttribute<decltype(Vertex::col)>(1, offsetof(Vertex, col)),
+			MakeVertexAttribute<decltype(Vertex::tex)>(2, offsetof(Vertex, tex))
+		}};
+	}
+
+	static Vertex Pack(const Vertex& vertex, const VertexQuantization& quantization);
+};
+
+// Positions as 16 bit fractions of the model's box (w unused), half float texture coords, no colour (12 bytes)
+struct QuantizedVertex
+{
+	Unorm16x4 pos;
+	Half2 tex;
+
+	static constexpr bool QUANTIZED = true;
+
+	static constexpr std::array<VkVertexInputAttributeDescription, 2> GetAttributes()
+	{
+		return {{
+			MakeVertexAttribute<decltype(QuantizedVertex::pos)>(0, offsetof(QuantizedVertex, pos)),
+			MakeVertexAttribute<decltype(QuantizedVertex::tex)>(2, offsetof(QuantizedVertex, tex))
+		}};
+	}
+
+	static QuantizedVertex Pack(const Vertex& vertex, const VertexQuantization& quantization);
+};
+
+// Same with an 8 bit colour (16 bytes)
+struct QuantizedColorVertex
+{
+	Unorm16x4 pos;
+	Half2 tex;
+	Unorm8x4 col;
+
+	static constexpr bool QUANTIZED = true;
+
+	static constexpr std::array<VkVertexInputAttributeDescription, 3> GetAttributes()
+	{
+		return {{
+			MakeVertexAttribute<decltype(QuantizedColorVertex::pos)>(0, offsetof(QuantizedColorVertex, pos)),
+			MakeVertexAttribute<decltype(QuantizedColorVertex::col)>(1, offsetof(QuantizedColorVertex, col)),
+			MakeVertexAttribute<decltype(QuantizedColorVertex::tex)>(2, offsetof(QuantizedColorVertex, tex))
+		}};
+	}
+
+	static QuantizedColorVertex Pack(const Vertex& vertex, const VertexQuantization& quantization);
+};
+
+static_assert(sizeof(Vertex) == 32, "Vertex has padding");
+static_assert(sizeof(QuantizedVertex) == 12, "QuantizedVertex has padding");
+static_assert(sizeof(QuantizedColorVertex) == 16, "QuantizedColorVertex has padding");
+
+// Layout meshes are stored in on the device, the pipelines' vertex input is generated from it
+using DeviceVertex = QuantizedVertex;
+
+// One binding of whole vertices, the attributes come from the layout's GetAttributes
+template <typename Layout>
+constexpr VkVertexInputBindingDescription GetVertexBindingDescription()
+{
+	return {0, sizeof(Layout), VK_VERTEX_INPUT_RATE_VERTEX};
+}
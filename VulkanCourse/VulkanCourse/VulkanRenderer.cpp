@@ -1,6 +1,7 @@
 #include "VulkanRenderer.h"
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <string>
 #include <set>
 
@@ -12,23 +13,54 @@ VulkanRenderer::VulkanRenderer(GLFWwindow* pWindow)
 	CreateSurface();
 	GetPhysicalDevice();
 	CreateLogicalDevice();
+	CreateMemoryAllocator();
 
 	CreateSwapChain();
+
+	InitRenderer();
+}
+
+VulkanRenderer::VulkanRenderer(const HeadlessSettings& settings)
+	:
+	headless(true)
+{
+	CreateInstance();
+	GetPhysicalDevice();
+	CreateLogicalDevice();
+	CreateMemoryAllocator();
+
+	// Need at least one offscreen image per frame in flight, so an image is never re-recorded while still in use
+	swapChainExtent = settings.extent;
+	CreateOffscreenImages(std::max(settings.frameCount, static_cast<uint32_t>(MAX_FRAME_DRAWS)));
+
+	InitRenderer();
+}
+
+void VulkanRenderer::InitRenderer()
+{
 	CreateColorBufferImage();
 	CreateDepthBufferImage();
 	CreateRenderPass();
 	CreateDescriptorSetLayout();
 	CreateGraphicsPipeline();
+	CreateCullPipeline();
 	CreateFrameBuffers();
 	CreateCommandPool();
 
 	CreateCommandBuffers();
+	CreateGpuProfiler();
+	CreateGeometryPool();
+	CreateUploadQueue();
+	CreateLoadingThreads();
 	CreateTextureSampler();
-	// AllocateDynamicBufferTransferSpace();
 	CreateUniformBuffers();
+	CreateIndirectBuffers();
 	CreateDescriptorPools();
 	CreateDescriptorSets();
 	CreateInputDescriptorSets();
+	CreateTextureDescriptorSets();
+	CreateIndirectDescriptorSets();
+	CreateCullDescriptorSets();
 	CreateSynchronization();
 
 	uboViewProjection.projection = glm::perspective(glm::radians(45.0f),
@@ -48,6 +80,13 @@ VulkanRenderer::~VulkanRenderer()
 	// wait until there are no actions on the device before destroying
 	VK_ERROR(vkDeviceWaitIdle(mainDevice.logicalDevice), "Failed to wait until the device was idle");
 
+	// Background loads still use the loading threads and geometry pool
+	for (auto& streaming : streamingModels)
+	{
+		DiscardStreamingModel(streaming);
+	}
+	streamingModels.clear();
+
 	for (auto& meshModel : modelList)
 	{
 		meshModel.DestroyMeshModel();
@@ -63,10 +102,12 @@ VulkanRenderer::~VulkanRenderer()
 
 	for (size_t i = 0; i < textureImages.size(); ++i)
 	{
+		if (textureImages[i] == VK_NULL_HANDLE) continue;
+
 		vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[i], nullptr);
 
 		vkDestroyImage(mainDevice.logicalDevice, textureImages[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, textureImageMemory[i], nullptr);
+		memoryAllocator->Free(textureImageMemory[i]);
 	}
 
 	for (size_t i = 0; i < MAX_FRAME_DRAWS; ++i)
@@ -76,6 +117,10 @@ VulkanRenderer::~VulkanRenderer()
 		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
 	}
 
+	gpuProfiler.DestroyProfiler();
+	uploadQueue.DestroyUploadQueue();
+	DestroyRecordingThreads();
+
 	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
 
 	for (auto framebuffer : swapChainFramebuffers)
@@ -85,36 +130,61 @@ VulkanRenderer::~VulkanRenderer()
 
 	vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, descriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, indirectSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, cullSetLayout, nullptr);
 
 	for (size_t i = 0; i < swapChainImages.size(); ++i)
 	{
 		vkDestroyBuffer(mainDevice.logicalDevice, vpUniformBuffers[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i], nullptr);
+		memoryAllocator->Free(vpUniformBufferMemory[i]);
+
+		vkDestroyBuffer(mainDevice.logicalDevice, indirectCommandBuffers[i], nullptr);
+		memoryAllocator->Free(indirectCommandBufferMemory[i]);
+
+		vkDestroyBuffer(mainDevice.logicalDevice, objectBuffers[i], nullptr);
+		memoryAllocator->Free(objectBufferMemory[i]);
 
-		/*vkDestroyBuffer(mainDevice.logicalDevice, modelDynamicUniformBuffers[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, modelDynamicUniformBufferMemory[i], nullptr);*/
+		vkDestroyBuffer(mainDevice.logicalDevice, instanceBuffers[i], nullptr);
+		memoryAllocator->Free(instanceBufferMemory[i]);
+
+		vkDestroyBuffer(mainDevice.logicalDevice, cullDrawBuffers[i], nullptr);
+		memoryAllocator->Free(cullDrawBufferMemory[i]);
+
+		vkDestroyBuffer(mainDevice.logicalDevice, batchCountBuffers[i], nullptr);
+		memoryAllocator->Free(batchCountBufferMemory[i]);
 	}
 
+	modelUniformRing.DestroyBuffer();
+	geometryPool->DestroyPool();
+
 	vkDestroyPipeline(mainDevice.logicalDevice, secondPipeline, nullptr);
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, secondPipelineLayout, nullptr);
 
 	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
 
+	vkDestroyPipeline(mainDevice.logicalDevice, instancePipeline, nullptr);
+
+	vkDestroyPipeline(mainDevice.logicalDevice, indirectPipeline, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, indirectPipelineLayout, nullptr);
+
+	vkDestroyPipeline(mainDevice.logicalDevice, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, cullPipelineLayout, nullptr);
+
 	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
 
 	for (size_t i = 0; i < depthBufferImages.size(); ++i)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageViews[i], nullptr);
 		vkDestroyImage(mainDevice.logicalDevice, depthBufferImages[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, depthBufferImageMemory[i], nullptr);
+		memoryAllocator->Free(depthBufferImageMemory[i]);
 	}
 
 	for (size_t i = 0; i < colorBufferImages.size(); ++i)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, colorBufferImageViews[i], nullptr);
 		vkDestroyImage(mainDevice.logicalDevice, colorBufferImages[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, colorBufferImageMemory[i], nullptr);
+		memoryAllocator->Free(colorBufferImageMemory[i]);
 	}
 
 	for (const auto& image : swapChainImages)
@@ -122,8 +192,22 @@ VulkanRenderer::~VulkanRenderer()
 		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
 	}
 
-	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	// Offscreen images are owned by the renderer, unlike swap chain images
+	for (size_t i = 0; i < offscreenImageMemory.size(); ++i)
+	{
+		vkDestroyImage(mainDevice.logicalDevice, swapChainImages[i].image, nullptr);
+		memoryAllocator->Free(offscreenImageMemory[i]);
+	}
+
+	memoryAllocator->DestroyAllocator();
+	memoryAllocator.reset();
+
+	// Headless never enables the swapchain or surface extensions
+	if (!headless)
+	{
+		vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
 	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
 
 	if (enableValidationLayers)
@@ -139,27 +223,76 @@ void VulkanRenderer::Draw()
 	// 1. Get next available image
 
 	// wait for given fence to signal (open) from last draw before continuing
+	const auto fenceWaitStart = std::chrono::high_resolution_clock::now();
 	VK_ERROR(vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_FALSE,
 	                         std::numeric_limits<uint64_t>::max()), "Failed to wait for fences");
-	// manually reset (close) the fence
-	VK_ERROR(vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]), "Failed to reset fence");
+	lastFenceWaitMs = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - fenceWaitStart).count();
+
+	// pick up GPU timings of any earlier frames that have finished (never waits)
+	gpuProfiler.CollectResults();
+	// and free upload batches (and their staging buffers) that have finished
+	uploadQueue.CollectFinished();
+	// and hand over whatever background loads have got ready
+	UpdateStreamingModels();
 
 	// get index of next image to be drawn to, and signal semaphore when ready to be drawn to
 	uint32_t imageIndex;
-	VK_ERROR(vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(),
-	                               imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex),
-	         "Failed to acquire next image"
-	);
+	if (headless)
+	{
+		// offscreen images are always available, so just cycle through them
+		imageIndex = nextOffscreenImage;
+		nextOffscreenImage = (nextOffscreenImage + 1) % static_cast<uint32_t>(swapChainImages.size());
+	}
+	else
+	{
+		VK_ERROR(vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(),
+		                               imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex),
+		         "Failed to acquire next image"
+		);
+	}
+
+	// The frame fence only covers the image this frame slot used last time. With more images than frames in
+	// flight (or images handed back out of order) another frame can still be using this one, and its uniforms,
+	// descriptors and command buffer are about to be rewritten
+	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+	{
+		VK_ERROR(vkWaitForFences(mainDevice.logicalDevice, 1, &imagesInFlight[imageIndex], VK_FALSE,
+		                         std::numeric_limits<uint64_t>::max()), "Failed to wait for fences");
+	}
+	imagesInFlight[imageIndex] = drawFences[currentFrame];
 
-	RecordCommands(imageIndex);
+	// manually reset (close) the fence, only now that nothing above waits on it
+	VK_ERROR(vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]), "Failed to reset fence");
+
+	// Visibility is needed by both the indirect commands and recording
+	if (cpuCulling)
+	{
+		CullDraws();
+	}
 
+	// Uniforms first, recording needs this frame's dynamic offsets
 	UpdateUniformBuffers(imageIndex);
+	UpdateTextureDescriptors(imageIndex);
+
+	// Cached command buffers are reused as long as nothing but transforms / camera has changed
+	// (the ring hands out the same offsets every frame while the model list is unchanged)
+	// CPU culled draws change every frame, unless they only change the indirect commands
+	const bool recordCulledDraws = cpuCulling && !indirectDrawing;
+	if (!cacheCommandBuffers || commandBufferDirty[imageIndex] || recordCulledDraws)
+	{
+		RecordCommands(imageIndex);
+		commandBufferDirty[imageIndex] = false;
+	}
 
 	// 2. Submit Command buffer to render
+	// uploads recorded since the last frame are submitted first, so this frame sees them
+	uploadQueue.Flush();
+
 	// queue submission information
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = headless ? 0 : 1; // nothing to acquire or present when headless
 	submitInfo.pWaitSemaphores = &imageAvailable[currentFrame];
 	VkPipelineStageFlags waitStages[] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT // Stages to check semaphores
@@ -167,12 +300,21 @@ void VulkanRenderer::Draw()
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffers[imageIndex]; // command buffer to submit
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];
 
 	VK_ERROR(vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFences[currentFrame]),
 	         "Failed to submit command buffer to graphics queue");
 
+	gpuProfiler.MarkSubmitted(imageIndex, frameNumber++);
+	lastImageIndex = imageIndex;
+
+	if (headless)
+	{
+		currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+		return;
+	}
+
 	// 3. Present rendered image to screen
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -195,6 +337,216 @@ void VulkanRenderer::UpdateModel(const uint32_t modelId, const glm::mat4 newMode
 	modelList[modelId].SetModel(newModel);
 }
 
+uint32_t VulkanRenderer::AddModelInstance(const uint32_t modelId, const glm::mat4 transform)
+{
+	if (modelId >= modelList.size())
+	{
+		throw std::runtime_error("Failed to add instance, model does not exist");
+	}
+
+	if (totalInstanceCount >= MAX_INSTANCES)
+	{
+		throw std::runtime_error("Failed to add instance, too many instances!");
+	}
+
+	modelInstances[modelId].push_back(transform);
+	++totalInstanceCount;
+
+	// Instance counts and offsets are recorded into the command buffers
+	MarkCommandBuffersDirty();
+
+	return static_cast<uint32_t>(modelInstances[modelId].size() - 1);
+}
+
+void VulkanRenderer::UpdateModelInstance(const uint32_t modelId, const uint32_t instanceId, const glm::mat4 transform)
+{
+	if (modelId >= modelInstances.size() || instanceId >= modelInstances[modelId].size()) return;
+
+	modelInstances[modelId][instanceId] = transform;
+}
+
+uint32_t VulkanRenderer::GetModelInstanceCount(const uint32_t modelId) const
+{
+	if (modelId >= modelInstances.size()) return 0;
+
+	return static_cast<uint32_t>(modelInstances[modelId].size());
+}
+
+bool VulkanRenderer::IsHeadless() const
+{
+	return headless;
+}
+
+VkExtent2D VulkanRenderer::GetExtent() const
+{
+	return swapChainExtent;
+}
+
+double VulkanRenderer::GetLastFenceWaitMs() const
+{
+	return lastFenceWaitMs;
+}
+
+GpuTimings VulkanRenderer::GetGpuTimings() const
+{
+	return gpuProfiler.GetTimings();
+}
+
+MemoryStats VulkanRenderer::GetMemoryStats() const
+{
+	return memoryAllocator->GetStats();
+}
+
+void VulkanRenderer::SetGpuProfilerLogInterval(const uint32_t frames)
+{
+	gpuProfiler.SetLogInterval(frames);
+}
+
+void VulkanRenderer::SetCommandBufferCaching(const bool enabled)
+{
+	cacheCommandBuffers = enabled;
+	MarkCommandBuffersDirty();
+}
+
+void VulkanRenderer::SetIndirectDrawing(const bool enabled)
+{
+	if (enabled && !indirectDrawingSupported)
+	{
+		throw std::runtime_error("Indirect drawing needs the drawIndirectFirstInstance device feature");
+	}
+
+	indirectDrawing = enabled;
+	MarkCommandBuffersDirty();
+}
+
+bool VulkanRenderer::IsIndirectDrawingSupported() const
+{
+	return indirectDrawingSupported;
+}
+
+void VulkanRenderer::SetGpuCulling(const bool enabled)
+{
+	if (enabled && !gpuCullingSupported)
+	{
+		throw std::runtime_error("GPU culling needs indirect drawing and a graphics queue that supports compute");
+	}
+
+	gpuCulling = enabled;
+	MarkCommandBuffersDirty();
+}
+
+bool VulkanRenderer::IsTransferQueueDedicated() const
+{
+	return uploadQueue.IsDedicated();
+}
+
+void VulkanRenderer::WaitForUploads()
+{
+	uploadQueue.WaitAll();
+}
+
+bool VulkanRenderer::IsGpuCullingSupported() const
+{
+	return gpuCullingSupported;
+}
+
+void VulkanRenderer::SetCpuCulling(const bool enabled)
+{
+	cpuCulling = enabled;
+	frustumCuller.ResetStats();
+	MarkCommandBuffersDirty();
+}
+
+CullStats VulkanRenderer::GetCullStats() const
+{
+	return frustumCuller.GetStats();
+}
+
+bool VulkanRenderer::CheckGpuCulling(std::string* mismatch)
+{
+	if (!indirectDrawing || !gpuCulling)
+	{
+		*mismatch = "GPU culling is not enabled";
+		return false;
+	}
+
+	// The commands are only complete once the frame that culled them has finished
+	VK_ERROR(vkDeviceWaitIdle(mainDevice.logicalDevice), "Failed to wait until the device was idle");
+
+	// Same boxes and view as that frame, tested on the CPU
+	CullDraws();
+
+	const auto* commands = static_cast<const VkDrawIndexedIndirectCommand*>(
+		indirectCommandBufferMemory[lastImageIndex].mappedData);
+
+	for (uint32_t batchIndex = 0; batchIndex < indirectBatches.size(); ++batchIndex)
+	{
+		const IndirectBatch& batch = indirectBatches[batchIndex];
+
+		// Draws as (first index, first object), the order within a batch depends on which invocation got there first
+		std::vector<std::pair<uint32_t, uint32_t>> expected;
+		std::vector<std::pair<uint32_t, uint32_t>> written;
+		bool packed = true;
+
+		for (uint32_t i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; ++i)
+		{
+			const MeshDraw& draw = indirectDraws[i];
+			const Mesh* mesh = modelList[draw.modelIndex].GetMesh(draw.meshIndex);
+
+			// The shader only tests single draws, instanced ones are always kept
+			if (GetDrawInstanceCount(draw.modelIndex) != 1 || drawVisible[draw.drawIndex])
+			{
+				expected.emplace_back(mesh->GetFirstIndex(), modelFirstObjects[draw.modelIndex]);
+			}
+
+			if (commands[i].instanceCount == 0) continue;
+
+			packed = packed && written.size() == i - batch.firstCommand;
+			written.emplace_back(commands[i].firstIndex, commands[i].firstInstance);
+		}
+
+		std::sort(expected.begin(), expected.end());
+		std::sort(written.begin(), written.end());
+
+		if (!packed || expected != written)
+		{
+			*mismatch = "Batch " + std::to_string(batchIndex) + ": the GPU kept " + std::to_string(written.size()) +
+				(packed ? "" : " (not packed)") + " of " + std::to_string(batch.commandCount) +
+				" draws, the CPU " + std::to_string(expected.size());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void VulkanRenderer::SetDrawSorting(const bool enabled)
+{
+	sortDraws = enabled;
+	MarkCommandBuffersDirty();
+}
+
+BindStats VulkanRenderer::GetBindStats() const
+{
+	return lastBindStats;
+}
+
+void VulkanRenderer::SetRecordingThreadCount(const uint32_t threadCount)
+{
+	// secondary command buffers may still be executing, so wait before replacing them
+	VK_ERROR(vkDeviceWaitIdle(mainDevice.logicalDevice), "Failed to wait until the device was idle");
+
+	DestroyRecordingThreads();
+
+	// a single thread gains nothing over recording inline
+	if (threadCount > 1)
+	{
+		CreateRecordingThreads(threadCount);
+	}
+
+	MarkCommandBuffersDirty();
+}
+
 void VulkanRenderer::CreateInstance()
 {
 	// Check to see if the application is requesting validation layers, and if so, make sure they are supported
@@ -237,7 +589,7 @@ void VulkanRenderer::CreateInstance()
 	}
 
 	// Create list to hold instance extensions
-	std::vector<const char*> instanceExtensions = GetRequiredGLFWExtensions();
+	std::vector<const char*> instanceExtensions = GetRequiredInstanceExtensions();
 
 	// check instance extensions supported
 	if (!CheckInstanceExtensionSupport(&instanceExtensions))
@@ -260,7 +612,7 @@ void VulkanRenderer::CreateLogicalDevice()
 
 	// Vector for queue creation information, and set for family indices
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> queueFamilyIndices = {indices.graphicsFamily, indices.presentationFamily};
+	std::set<int> queueFamilyIndices = {indices.graphicsFamily, indices.presentationFamily, indices.transferFamily};
 
 	float priority = 1.0f;
 
@@ -283,13 +635,41 @@ void VulkanRenderer::CreateLogicalDevice()
 	// Number of queue create infos
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	// List of queue create infos so device can create required queues
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+	deviceCreateInfo.enabledExtensionCount = headless ? 0 : static_cast<uint32_t>(deviceExtensions.size());
 	// number of enabled logical device extensions
 	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data(); // List of enabled logical device extensions
 
+	// Optional features, only enabled when the device has them
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures);
+
+	indirectDrawingSupported = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+	multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+	compressedTexturesSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+	// Decoded textures get their mip chain blitted down from the first level, which the format has to allow
+	VkFormatProperties textureFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(mainDevice.physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &textureFormatProperties);
+	const VkFormatFeatureFlags mipmapFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	mipmapGenerationSupported = (textureFormatProperties.optimalTilingFeatures & mipmapFeatures) == mipmapFeatures;
+
+	// Culling runs in the same command buffer as the draws, so the graphics queue has to take compute work too
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, queueFamilyList.data());
+
+	gpuCullingSupported = indirectDrawingSupported &&
+		(queueFamilyList[indices.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+
 	// physical device features that logical device will be using
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE; // texture array indexed by the pushed texture id
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
 
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures; // Physical device features logical device will use
 
@@ -301,6 +681,12 @@ void VulkanRenderer::CreateLogicalDevice()
 	// From a given logical device, of a given queue family, of a given queue index, store our queue
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+	vkGetDeviceQueue(mainDevice.logicalDevice, indices.transferFamily, 0, &transferQueue);
+}
+
+void VulkanRenderer::CreateMemoryAllocator()
+{
+	memoryAllocator = std::make_unique<DeviceMemoryAllocator>(mainDevice.physicalDevice, mainDevice.logicalDevice);
 }
 
 void VulkanRenderer::CreateSurface()
@@ -398,6 +784,35 @@ void VulkanRenderer::CreateSwapChain()
 	}
 }
 
+void VulkanRenderer::CreateOffscreenImages(const uint32_t imageCount)
+{
+	swapChainImageFormat = ChooseSupportedFormat(
+		{VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM},
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+	);
+
+	offscreenImageMemory.resize(imageCount);
+
+	for (uint32_t i = 0; i < imageCount; ++i)
+	{
+		// Offscreen images take the place of swap chain images, and can be copied out for inspection
+		const VkImage image = CreateImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat,
+		                                  VK_IMAGE_TILING_OPTIMAL,
+		                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                                  &offscreenImageMemory[i]
+		);
+
+		SwapChainImage offscreenImage{
+			image,
+			CreateImageView(image, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT)
+		};
+
+		swapChainImages.push_back(offscreenImage);
+	}
+}
+
 void VulkanRenderer::CreateRenderPass()
 {
 	// Array of subPasses
@@ -464,7 +879,8 @@ void VulkanRenderer::CreateRenderPass()
 	// Framebuffer data will be stored as an image, but images can be given different data layouts to give optimal use for certain operations
 	swapChainColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	// the expected layout before the render pass starts
-	swapChainColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // image data layout after the render pass
+	swapChainColorAttachment.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// image data layout after the render pass (offscreen images are left ready to be copied out)
 
 	VkAttachmentReference swapChainColorAttachmentReference = {};
 	swapChainColorAttachmentReference.attachment = 0;
@@ -549,13 +965,13 @@ void VulkanRenderer::CreateDescriptorSetLayout()
 	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 	// model binding info
-	/*VkDescriptorSetLayoutBinding modelLayoutBinding = {};
+	VkDescriptorSetLayoutBinding modelLayoutBinding = {};
 	modelLayoutBinding.binding = 1;
 	modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	modelLayoutBinding.descriptorCount = 1;
-	modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;*/
+	modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	std::vector<VkDescriptorSetLayoutBinding> bindings = {vpLayoutBinding};
+	std::vector<VkDescriptorSetLayoutBinding> bindings = {vpLayoutBinding, modelLayoutBinding};
 
 	// Create Descriptor Set Layout with given bindings
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
@@ -566,12 +982,62 @@ void VulkanRenderer::CreateDescriptorSetLayout()
 	VK_ERROR(vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &layoutCreateInfo, nullptr, &descriptorSetLayout),
 	         "Failed to create descriptor set layout");
 
+	// CREATE INDIRECT DESCRIPTOR SET LAYOUT
+	// Same view projection binding, but models are read from one array instead of at a dynamic offset
+	VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+	objectLayoutBinding.binding = 1;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	std::array<VkDescriptorSetLayoutBinding, 2> indirectBindings = {vpLayoutBinding, objectLayoutBinding};
+
+	VkDescriptorSetLayoutCreateInfo indirectLayoutCreateInfo{};
+	indirectLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	indirectLayoutCreateInfo.bindingCount = static_cast<uint32_t>(indirectBindings.size());
+	indirectLayoutCreateInfo.pBindings = indirectBindings.data();
+
+	VK_ERROR(
+		vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &indirectLayoutCreateInfo, nullptr, &indirectSetLayout),
+		"Failed to create indirect descriptor set layout");
+
+	// CREATE CULL DESCRIPTOR SET LAYOUT
+	// View projection for the frustum, models and cull inputs to read, indirect commands and batch counters to write
+	std::array<VkDescriptorSetLayoutBinding, 5> cullBindings = {};
+	for (uint32_t i = 0; i < cullBindings.size(); ++i)
+	{
+		cullBindings[i].binding = i;
+		cullBindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		cullBindings[i].descriptorCount = 1;
+		cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo cullLayoutCreateInfo{};
+	cullLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	cullLayoutCreateInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+	cullLayoutCreateInfo.pBindings = cullBindings.data();
+
+	VK_ERROR(vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &cullLayoutCreateInfo, nullptr, &cullSetLayout),
+	         "Failed to create cull descriptor set layout");
+
 	// CREATE TEXTURE SAMPLER DESCRIPTOR SET LAYOUT
 
+	// One array of every texture, as large as the device allows (up to MAX_TEXTURES)
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+
+	textureArraySize = std::min({
+		static_cast<uint32_t>(MAX_TEXTURES),
+		deviceProperties.limits.maxPerStageDescriptorSamplers,
+		deviceProperties.limits.maxPerStageDescriptorSampledImages,
+		deviceProperties.limits.maxDescriptorSetSamplers,
+		deviceProperties.limits.maxDescriptorSetSampledImages
+	});
+
 	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
 	samplerLayoutBinding.binding = 0;
 	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.descriptorCount = textureArraySize;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo{};
@@ -610,13 +1076,6 @@ void VulkanRenderer::CreateDescriptorSetLayout()
 	         "Failed to create input descriptor set layout");
 }
 
-void VulkanRenderer::CreatePushConstantRange()
-{
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(Model);
-}
-
 void VulkanRenderer::CreateGraphicsPipeline()
 {
 	// read in SPIR-V shader code
@@ -642,37 +1101,27 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	fragmentShaderCreateInfo.module = fragmentShaderModule;
 	fragmentShaderCreateInfo.pName = "main"; // the name of the function to run in the shader
 
+	// Size the fragment shader's texture array to match the descriptor set layout
+	VkSpecializationMapEntry textureCountEntry = {};
+	textureCountEntry.constantID = 0;
+	textureCountEntry.offset = 0;
+	textureCountEntry.size = sizeof(uint32_t);
+
+	VkSpecializationInfo textureSpecialization = {};
+	textureSpecialization.mapEntryCount = 1;
+	textureSpecialization.pMapEntries = &textureCountEntry;
+	textureSpecialization.dataSize = sizeof(uint32_t);
+	textureSpecialization.pData = &textureArraySize;
+
+	fragmentShaderCreateInfo.pSpecializationInfo = &textureSpecialization;
+
 	// shader stage creation info array (required by pipeline)
 	VkPipelineShaderStageCreateInfo shaderStages[] = {vertexShaderCreateInfo, fragmentShaderCreateInfo};
 
-	// How the data or a single vertex (including info such as position, color, tex coords, normals, etc) is as a whole
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0; // can bind multiple streams of data, this defines which one
-	bindingDescription.stride = sizeof(Vertex);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; // How to move between data after each vertex
-
-	// How the data for an attribute is defined within a vertex
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-
-	// Position Attribute
-	attributeDescriptions[0].binding = 0; // Which binding the data is at (should be same as above)
-	attributeDescriptions[0].location = 0; // The location for the attribute in the shader
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	// Format the data will take (also helps define the size of data)
-	attributeDescriptions[0].offset = offsetof(Vertex, pos);
-	// Where this attribute is defined in the data for a single vertex
-
-	// Color Attribute
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, col);
-
-	// Texture Attribute
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, tex);
+	// How the data or a single vertex (including info such as position, color, tex coords, normals, etc) is as a whole,
+	// and how each attribute is defined within it. Both follow from the device vertex layout
+	constexpr VkVertexInputBindingDescription bindingDescription = GetVertexBindingDescription<DeviceVertex>();
+	constexpr auto attributeDescriptions = DeviceVertex::GetAttributes();
 
 	// -- Vertex Input --
 	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
@@ -767,17 +1216,21 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	colorBlendStateCreateInfo.attachmentCount = 1;
 	colorBlendStateCreateInfo.pAttachments = &colorBlendAttachment;
 
-	CreatePushConstantRange();
-
 	// -- Pipeline Layout --
 	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = {descriptorSetLayout, samplerSetLayout};
 
+	// Texture id of each draw
+	VkPushConstantRange texturePushConstantRange = {};
+	texturePushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	texturePushConstantRange.offset = 0;
+	texturePushConstantRange.size = sizeof(int);
+
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 	pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
 	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &texturePushConstantRange;
 
 	// Create Pipeline Layout
 	VK_ERROR(vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout),
@@ -820,7 +1273,79 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	         "Failed to create graphics pipeline"
 	);
 
+	// Create instance pipeline, same as the graphics pipeline plus a per instance transform from a second vertex buffer
+	const auto instanceVertexShader = ReadFile("Shaders/InstanceShader.vert.spv");
+	VkShaderModule instanceVertexShaderModule = CreateShaderModule(instanceVertexShader);
+
+	vertexShaderCreateInfo.module = instanceVertexShaderModule;
+	VkPipelineShaderStageCreateInfo instanceShaderStages[] = {vertexShaderCreateInfo, fragmentShaderCreateInfo};
+
+	VkVertexInputBindingDescription instanceBindingDescription = {};
+	instanceBindingDescription.binding = 1;
+	instanceBindingDescription.stride = sizeof(glm::mat4);
+	instanceBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE; // Move on once per instance
+
+	std::array<VkVertexInputBindingDescription, 2> instanceBindings = {bindingDescription, instanceBindingDescription};
+
+	// Vertex attributes, then the transform as four column attributes (locations 3 to 6)
+	const size_t vertexAttributeCount = attributeDescriptions.size();
+	std::array<VkVertexInputAttributeDescription, attributeDescriptions.size() + 4> instanceAttributes{};
+	std::copy(attributeDescriptions.begin(), attributeDescriptions.end(), instanceAttributes.begin());
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		instanceAttributes[vertexAttributeCount + i].binding = 1;
+		instanceAttributes[vertexAttributeCount + i].location = 3 + i;
+		instanceAttributes[vertexAttributeCount + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		instanceAttributes[vertexAttributeCount + i].offset = sizeof(glm::vec4) * i;
+	}
+
+	VkPipelineVertexInputStateCreateInfo instanceInputCreateInfo = vertexInputCreateInfo;
+	instanceInputCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instanceBindings.size());
+	instanceInputCreateInfo.pVertexBindingDescriptions = instanceBindings.data();
+	instanceInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instanceAttributes.size());
+	instanceInputCreateInfo.pVertexAttributeDescriptions = instanceAttributes.data();
+
+	pipelineCreateInfo.pStages = instanceShaderStages;
+	pipelineCreateInfo.pVertexInputState = &instanceInputCreateInfo;
+
+	VK_ERROR(vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
+	                                   &instancePipeline), "Failed to create instance graphics pipeline");
+
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+
+	// Create indirect pipeline, same as the graphics pipeline but with the model picked by the instance index.
+	// Only when indirect drawing can be turned on, the index comes from each command's firstInstance
+	if (indirectDrawingSupported)
+	{
+		const auto indirectVertexShader = ReadFile("Shaders/IndirectShader.vert.spv");
+		VkShaderModule indirectVertexShaderModule = CreateShaderModule(indirectVertexShader);
+
+		vertexShaderCreateInfo.module = indirectVertexShaderModule;
+		VkPipelineShaderStageCreateInfo indirectShaderStages[] = {vertexShaderCreateInfo, fragmentShaderCreateInfo};
+
+		std::array<VkDescriptorSetLayout, 2> indirectSetLayouts = {indirectSetLayout, samplerSetLayout};
+
+		VkPipelineLayoutCreateInfo indirectPipelineLayoutCreateInfo = {};
+		indirectPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		indirectPipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(indirectSetLayouts.size());
+		indirectPipelineLayoutCreateInfo.pSetLayouts = indirectSetLayouts.data();
+		indirectPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		indirectPipelineLayoutCreateInfo.pPushConstantRanges = &texturePushConstantRange;
+
+		VK_ERROR(vkCreatePipelineLayout(mainDevice.logicalDevice, &indirectPipelineLayoutCreateInfo, nullptr,
+		                                &indirectPipelineLayout), "Failed to create indirect pipeline layout");
+
+		pipelineCreateInfo.pStages = indirectShaderStages;
+		pipelineCreateInfo.layout = indirectPipelineLayout;
+
+		VK_ERROR(vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
+		                                   &indirectPipeline), "Failed to create indirect graphics pipeline");
+
+		vkDestroyShaderModule(mainDevice.logicalDevice, indirectVertexShaderModule, nullptr);
+	}
+
 	// Destroy shader modules no longer needed after pipeline created
+	vkDestroyShaderModule(mainDevice.logicalDevice, instanceVertexShaderModule, nullptr);
 	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
 	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
 
@@ -872,25 +1397,68 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	vkDestroyShaderModule(mainDevice.logicalDevice, secondVertexShaderModule, nullptr);
 }
 
-void VulkanRenderer::CreateColorBufferImage()
+void VulkanRenderer::CreateCullPipeline()
 {
-	colorBufferImages.resize(swapChainImages.size());
-	colorBufferImageMemory.resize(swapChainImages.size());
-	colorBufferImageViews.resize(swapChainImages.size());
+	// Only needed when GPU culling can be turned on (SetGpuCulling checks the same)
+	if (!gpuCullingSupported) return;
 
-	// Get supported format for color attachment
-	const VkFormat colorFormat = ChooseSupportedFormat(
-		{VK_FORMAT_R8G8B8A8_UNORM},
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	);
+	const auto cullShader = ReadFile("Shaders/CullShader.comp.spv");
+	VkShaderModule cullShaderModule = CreateShaderModule(cullShader);
 
-	for (size_t i = 0; i < swapChainImages.size(); ++i)
-	{
-		// Create color buffer image
-		colorBufferImages[i] = CreateImage(swapChainExtent.width, swapChainExtent.height, colorFormat,
-		                                   VK_IMAGE_TILING_OPTIMAL,
-		                                   VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+	VkPipelineShaderStageCreateInfo cullShaderCreateInfo = {};
+	cullShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	cullShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullShaderCreateInfo.module = cullShaderModule;
+	cullShaderCreateInfo.pName = "main";
+
+	// Number of draws to test
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &cullSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	VK_ERROR(vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout),
+	         "Failed to create cull pipeline layout");
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = cullShaderCreateInfo;
+	pipelineCreateInfo.layout = cullPipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	VK_ERROR(vkCreateComputePipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
+	                                  &cullPipeline), "Failed to create cull compute pipeline");
+
+	vkDestroyShaderModule(mainDevice.logicalDevice, cullShaderModule, nullptr);
+}
+
+void VulkanRenderer::CreateColorBufferImage()
+{
+	colorBufferImages.resize(swapChainImages.size());
+	colorBufferImageMemory.resize(swapChainImages.size());
+	colorBufferImageViews.resize(swapChainImages.size());
+
+	// Get supported format for color attachment
+	const VkFormat colorFormat = ChooseSupportedFormat(
+		{VK_FORMAT_R8G8B8A8_UNORM},
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	);
+
+	for (size_t i = 0; i < swapChainImages.size(); ++i)
+	{
+		// Create color buffer image
+		colorBufferImages[i] = CreateImage(swapChainExtent.width, swapChainExtent.height, colorFormat,
+		                                   VK_IMAGE_TILING_OPTIMAL,
+		                                   VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
 		                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		                                   &colorBufferImageMemory[i]
 		);
@@ -975,6 +1543,7 @@ void VulkanRenderer::CreateCommandBuffers()
 {
 	// resize command buffer count to be 1:1 with frame buffers
 	commandBuffers.resize(swapChainFramebuffers.size());
+	commandBufferDirty.resize(swapChainFramebuffers.size(), true);
 
 	VkCommandBufferAllocateInfo cBAllocateInfo = {};
 	cBAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -990,27 +1559,77 @@ void VulkanRenderer::CreateCommandBuffers()
 void VulkanRenderer::CreateUniformBuffers()
 {
 	const VkDeviceSize vpBufferSize = sizeof(UboViewProjection);
-	//const VkDeviceSize modelBufferSize = modelUniformAlignment * MAX_OBJECTS;
 
 	// One uniform buffer for each image / command buffer
 	vpUniformBuffers.resize(swapChainImages.size());
 	vpUniformBufferMemory.resize(swapChainImages.size());
 
-	//modelDynamicUniformBuffers.resize(swapChainImages.size());
-	//modelDynamicUniformBufferMemory.resize(swapChainImages.size());
+	// Written every frame, so they stay mapped instead of being mapped for each update
+	vpUniformBufferMapped.resize(swapChainImages.size());
 
 	// Create uniform buffers
 	for (size_t i = 0; i < swapChainImages.size(); ++i)
 	{
-		CreateBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, vpBufferSize,
+		CreateBuffer(memoryAllocator.get(), mainDevice.logicalDevice, vpBufferSize,
 		             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		             &vpUniformBuffers[i], &vpUniformBufferMemory[i]);
 
-		/*CreateBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, modelBufferSize,
-		             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		// Allocator keeps host visible memory mapped, and it is host coherent, so writes need no flush
+		vpUniformBufferMapped[i] = static_cast<UboViewProjection*>(vpUniformBufferMemory[i].mappedData);
+	}
+
+	// Per object data of all images lives in one ring buffer, allocated from at dynamic offsets
+	modelUniformRing = UniformRingBuffer(memoryAllocator.get(), mainDevice.logicalDevice, minUniformBufferOffset,
+	                                     UNIFORM_RING_FRAME_SIZE, static_cast<uint32_t>(swapChainImages.size()));
+}
+
+void VulkanRenderer::CreateIndirectBuffers()
+{
+	const VkDeviceSize commandBufferSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_INDIRECT_DRAWS;
+	const VkDeviceSize objectBufferSize = sizeof(glm::mat4) * (MAX_OBJECTS + MAX_INSTANCES);
+
+	// One of each for each image, written by the CPU every frame the indirect path is used
+	indirectCommandBuffers.resize(swapChainImages.size());
+	indirectCommandBufferMemory.resize(swapChainImages.size());
+	objectBuffers.resize(swapChainImages.size());
+	objectBufferMemory.resize(swapChainImages.size());
+	instanceBuffers.resize(swapChainImages.size());
+	instanceBufferMemory.resize(swapChainImages.size());
+	cullDrawBuffers.resize(swapChainImages.size());
+	cullDrawBufferMemory.resize(swapChainImages.size());
+	batchCountBuffers.resize(swapChainImages.size());
+	batchCountBufferMemory.resize(swapChainImages.size());
+
+	for (size_t i = 0; i < swapChainImages.size(); ++i)
+	{
+		// Also written by the cull pass when culling on the GPU
+		CreateBuffer(memoryAllocator.get(), mainDevice.logicalDevice, commandBufferSize,
+		             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		             &indirectCommandBuffers[i], &indirectCommandBufferMemory[i]);
+
+		CreateBuffer(memoryAllocator.get(), mainDevice.logicalDevice, objectBufferSize,
+		             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		             &objectBuffers[i], &objectBufferMemory[i]);
+
+		CreateBuffer(memoryAllocator.get(), mainDevice.logicalDevice, sizeof(glm::mat4) * MAX_INSTANCES,
+		             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		             &instanceBuffers[i], &instanceBufferMemory[i]);
+
+		CreateBuffer(memoryAllocator.get(), mainDevice.logicalDevice, sizeof(CullDraw) * MAX_INDIRECT_DRAWS,
+		             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		             &modelDynamicUniformBuffers[i], &modelDynamicUniformBufferMemory[i]);*/
+		             &cullDrawBuffers[i], &cullDrawBufferMemory[i]);
+
+		// Can't have more batches than draws
+		CreateBuffer(memoryAllocator.get(), mainDevice.logicalDevice, sizeof(uint32_t) * MAX_INDIRECT_DRAWS,
+		             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		             &batchCountBuffers[i], &batchCountBufferMemory[i]);
 	}
 }
 
@@ -1023,15 +1642,25 @@ void VulkanRenderer::CreateDescriptorPools()
 	vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffers.size());
 
-	/*VkDescriptorPoolSize modelPoolSize{};
+	VkDescriptorPoolSize modelPoolSize{};
 	modelPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	modelPoolSize.descriptorCount = static_cast<uint32_t>(modelDynamicUniformBuffers.size());*/
+	modelPoolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+
+	// Indirect and cull sets each need another view projection descriptor, plus the model array
+	// (and for culling the cull inputs, indirect commands and batch counters)
+	VkDescriptorPoolSize indirectVpPoolSize{};
+	indirectVpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	indirectVpPoolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
 
-	std::vector<VkDescriptorPoolSize> poolSizes = {vpPoolSize};
+	VkDescriptorPoolSize objectPoolSize{};
+	objectPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectPoolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 5);
+
+	std::vector<VkDescriptorPoolSize> poolSizes = {vpPoolSize, modelPoolSize, indirectVpPoolSize, objectPoolSize};
 
 	VkDescriptorPoolCreateInfo poolCreateInfo{};
 	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+	poolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size() * 3); // regular, indirect and cull sets
 	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolCreateInfo.pPoolSizes = poolSizes.data();
 
@@ -1042,11 +1671,11 @@ void VulkanRenderer::CreateDescriptorPools()
 	// CREATE SAMPLER DESCRIPTOR POOL
 	VkDescriptorPoolSize samplerPoolSize{};
 	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPoolSize.descriptorCount = MAX_OBJECTS;
+	samplerPoolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * textureArraySize;
 
 	VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
 	samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
+	samplerPoolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
 	samplerPoolCreateInfo.poolSizeCount = 1;
 	samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
 
@@ -1108,11 +1737,11 @@ void VulkanRenderer::CreateDescriptorSets()
 		vpSetWrite.dstArrayElement = 0;
 		vpSetWrite.pBufferInfo = &vpBufferInfo;
 
-		// Model Descriptor
-		/*VkDescriptorBufferInfo modelBufferInfo = {};
-		modelBufferInfo.buffer = modelDynamicUniformBuffers[i];
+		// Model Descriptor (the offset into the ring is given when binding)
+		VkDescriptorBufferInfo modelBufferInfo = {};
+		modelBufferInfo.buffer = modelUniformRing.GetBuffer();
 		modelBufferInfo.offset = 0;
-		modelBufferInfo.range = modelUniformAlignment;
+		modelBufferInfo.range = sizeof(UboModel);
 
 		VkWriteDescriptorSet modelSetWrite = {};
 		modelSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1121,15 +1750,138 @@ void VulkanRenderer::CreateDescriptorSets()
 		modelSetWrite.dstSet = descriptorSets[i];
 		modelSetWrite.dstBinding = 1;
 		modelSetWrite.dstArrayElement = 0;
-		modelSetWrite.pBufferInfo = &modelBufferInfo;*/
+		modelSetWrite.pBufferInfo = &modelBufferInfo;
+
+		std::vector<VkWriteDescriptorSet> descriptorSetWrites = {vpSetWrite, modelSetWrite};
+
+		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(descriptorSetWrites.size()),
+		                       descriptorSetWrites.data(), 0, nullptr);
+	}
+}
+
+void VulkanRenderer::CreateIndirectDescriptorSets()
+{
+	indirectDescriptorSets.resize(swapChainImages.size());
+
+	std::vector<VkDescriptorSetLayout> setLayouts(swapChainImages.size(), indirectSetLayout);
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+	setAllocInfo.pSetLayouts = setLayouts.data();
+
+	VK_ERROR(vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, indirectDescriptorSets.data()),
+	         "Failed to allocate indirect descriptor sets");
+
+	for (size_t i = 0; i < swapChainImages.size(); ++i)
+	{
+		// View Projection Descriptor
+		VkDescriptorBufferInfo vpBufferInfo = {};
+		vpBufferInfo.buffer = vpUniformBuffers[i];
+		vpBufferInfo.offset = 0;
+		vpBufferInfo.range = sizeof(UboViewProjection);
+
+		VkWriteDescriptorSet vpSetWrite = {};
+		vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		vpSetWrite.descriptorCount = 1;
+		vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vpSetWrite.dstSet = indirectDescriptorSets[i];
+		vpSetWrite.dstBinding = 0;
+		vpSetWrite.dstArrayElement = 0;
+		vpSetWrite.pBufferInfo = &vpBufferInfo;
+
+		// Model Array Descriptor
+		VkDescriptorBufferInfo objectBufferInfo = {};
+		objectBufferInfo.buffer = objectBuffers[i];
+		objectBufferInfo.offset = 0;
+		objectBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet objectSetWrite = {};
+		objectSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		objectSetWrite.descriptorCount = 1;
+		objectSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		objectSetWrite.dstSet = indirectDescriptorSets[i];
+		objectSetWrite.dstBinding = 1;
+		objectSetWrite.dstArrayElement = 0;
+		objectSetWrite.pBufferInfo = &objectBufferInfo;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorSetWrites = {vpSetWrite, objectSetWrite};
+
+		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(descriptorSetWrites.size()),
+		                       descriptorSetWrites.data(), 0, nullptr);
+	}
+}
+
+void VulkanRenderer::CreateCullDescriptorSets()
+{
+	cullDescriptorSets.resize(swapChainImages.size());
+
+	std::vector<VkDescriptorSetLayout> setLayouts(swapChainImages.size(), cullSetLayout);
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+	setAllocInfo.pSetLayouts = setLayouts.data();
 
-		std::vector<VkWriteDescriptorSet> descriptorSetWrites = {vpSetWrite};
+	VK_ERROR(vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, cullDescriptorSets.data()),
+	         "Failed to allocate cull descriptor sets");
+
+	for (size_t i = 0; i < swapChainImages.size(); ++i)
+	{
+		// In binding order: view projection, models, cull inputs, indirect commands, batch counters
+		std::array<VkDescriptorBufferInfo, 5> bufferInfos = {};
+		bufferInfos[0] = {vpUniformBuffers[i], 0, sizeof(UboViewProjection)};
+		bufferInfos[1] = {objectBuffers[i], 0, VK_WHOLE_SIZE};
+		bufferInfos[2] = {cullDrawBuffers[i], 0, VK_WHOLE_SIZE};
+		bufferInfos[3] = {indirectCommandBuffers[i], 0, VK_WHOLE_SIZE};
+		bufferInfos[4] = {batchCountBuffers[i], 0, VK_WHOLE_SIZE};
+
+		std::array<VkWriteDescriptorSet, 5> descriptorSetWrites = {};
+		for (uint32_t j = 0; j < descriptorSetWrites.size(); ++j)
+		{
+			descriptorSetWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorSetWrites[j].descriptorCount = 1;
+			descriptorSetWrites[j].descriptorType = j == 0
+				                                        ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+				                                        : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorSetWrites[j].dstSet = cullDescriptorSets[i];
+			descriptorSetWrites[j].dstBinding = j;
+			descriptorSetWrites[j].dstArrayElement = 0;
+			descriptorSetWrites[j].pBufferInfo = &bufferInfos[j];
+		}
 
 		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(descriptorSetWrites.size()),
 		                       descriptorSetWrites.data(), 0, nullptr);
 	}
 }
 
+void VulkanRenderer::CreateTextureDescriptorSets()
+{
+	samplerDescriptorSets.resize(swapChainImages.size());
+
+	// Nothing has been written yet, and the shader can read any slot
+	std::vector<uint32_t> allTextureSlots(textureArraySize);
+	for (uint32_t i = 0; i < textureArraySize; ++i)
+	{
+		allTextureSlots[i] = i;
+	}
+	textureDescriptorWrites.assign(swapChainImages.size(), allTextureSlots);
+
+	std::vector<VkDescriptorSetLayout> setLayouts(swapChainImages.size(), samplerSetLayout);
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = samplerDescriptorPool;
+	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+	setAllocInfo.pSetLayouts = setLayouts.data();
+
+	// Textures are written in later, by UpdateTextureDescriptors
+	VK_ERROR(vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, samplerDescriptorSets.data()),
+	         "Failed to allocate texture descriptor sets");
+}
+
 void VulkanRenderer::CreateInputDescriptorSets()
 {
 	inputDescriptorSets.resize(swapChainImages.size());
@@ -1196,6 +1948,7 @@ void VulkanRenderer::CreateSynchronization()
 	imageAvailable.resize(MAX_FRAME_DRAWS);
 	renderFinished.resize(MAX_FRAME_DRAWS);
 	drawFences.resize(MAX_FRAME_DRAWS);
+	imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
 
 	// Semaphore creation information
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
@@ -1217,6 +1970,87 @@ void VulkanRenderer::CreateSynchronization()
 	}
 }
 
+void VulkanRenderer::CreateGpuProfiler()
+{
+	const QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	// One set of timestamp queries per command buffer
+	gpuProfiler = GpuProfiler(mainDevice.physicalDevice, mainDevice.logicalDevice,
+	                          static_cast<uint32_t>(queueFamilyIndices.graphicsFamily),
+	                          static_cast<uint32_t>(commandBuffers.size()));
+}
+
+void VulkanRenderer::CreateGeometryPool()
+{
+	geometryPool = std::make_unique<GeometryPool>(memoryAllocator.get(), mainDevice.logicalDevice);
+}
+
+void VulkanRenderer::CreateUploadQueue()
+{
+	const QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	uploadQueue = UploadQueue(memoryAllocator.get(), mainDevice.logicalDevice, queueFamilyIndices, transferQueue,
+	                          graphicsQueue);
+}
+
+void VulkanRenderer::CreateLoadingThreads()
+{
+	// hardware_concurrency can be 0 when it isn't known
+	loadingThreads = std::make_unique<ThreadPool>(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+void VulkanRenderer::CreateRecordingThreads(const uint32_t threadCount)
+{
+	recordingThreads = std::make_unique<ThreadPool>(threadCount);
+
+	const QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	recordingCommandPools.resize(threadCount);
+	secondaryCommandBuffers.assign(commandBuffers.size(), std::vector<VkCommandBuffer>(threadCount));
+
+	for (uint32_t chunk = 0; chunk < threadCount; ++chunk)
+	{
+		// Command pools aren't thread safe, so each chunk gets its own
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		VK_ERROR(vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &recordingCommandPools[chunk]),
+		         "Failed to create recording command pool");
+
+		// One secondary command buffer per image for this chunk
+		std::vector<VkCommandBuffer> chunkBuffers(commandBuffers.size());
+
+		VkCommandBufferAllocateInfo cBAllocateInfo = {};
+		cBAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cBAllocateInfo.commandPool = recordingCommandPools[chunk];
+		cBAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		cBAllocateInfo.commandBufferCount = static_cast<uint32_t>(chunkBuffers.size());
+
+		VK_ERROR(vkAllocateCommandBuffers(mainDevice.logicalDevice, &cBAllocateInfo, chunkBuffers.data()),
+		         "Failed to allocate secondary command buffers");
+
+		for (size_t image = 0; image < chunkBuffers.size(); ++image)
+		{
+			secondaryCommandBuffers[image][chunk] = chunkBuffers[image];
+		}
+	}
+}
+
+void VulkanRenderer::DestroyRecordingThreads()
+{
+	// Destroying the pools frees their secondary command buffers too
+	for (auto commandPool : recordingCommandPools)
+	{
+		vkDestroyCommandPool(mainDevice.logicalDevice, commandPool, nullptr);
+	}
+
+	recordingCommandPools.clear();
+	secondaryCommandBuffers.clear();
+	recordingThreads.reset();
+}
+
 void VulkanRenderer::CreateTextureSampler()
 {
 	VkSamplerCreateInfo samplerCreateInfo = {};
@@ -1232,7 +2066,7 @@ void VulkanRenderer::CreateTextureSampler()
 	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerCreateInfo.mipLodBias = 0.0f;
 	samplerCreateInfo.minLod = 0;
-	samplerCreateInfo.maxLod = 0;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE; // every level a texture has
 	samplerCreateInfo.anisotropyEnable = VK_TRUE;
 	samplerCreateInfo.maxAnisotropy = 16;
 
@@ -1265,52 +2099,66 @@ void VulkanRenderer::RecordCommands(const uint32_t currentImage)
 
 	renderPassBeginInfo.framebuffer = swapChainFramebuffers[currentImage];
 
+	// Binds are only counted for frames that are recorded
+	lastBindStats = BindStats();
+
+	if (!indirectDrawing)
+	{
+		BuildDrawList();
+	}
+
+	// Geometry subpass is either recorded inline, or in parallel into secondary command buffers
+	// (the indirect path is only a few calls, so it is always recorded inline)
+	const bool recordInParallel = recordingThreads != nullptr && !indirectDrawing;
+	const VkSubpassContents geometryContents = recordInParallel
+		                                           ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+		                                           : VK_SUBPASS_CONTENTS_INLINE;
+
 	// begin command buffer
 	VK_ERROR(vkBeginCommandBuffer(commandBuffers[currentImage], &bufferBeginInfo),
 	         "Failed to start recording a command buffer");
 	{
+		gpuProfiler.ResetSlot(commandBuffers[currentImage], currentImage);
+		gpuProfiler.WriteTimestamp(commandBuffers[currentImage], currentImage, GpuProfiler::COMMAND_BUFFER_BEGIN,
+		                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+		// Compute work can't be inside a render pass, so the indirect commands are built first
+		if (indirectDrawing && gpuCulling)
+		{
+			RecordCulling(commandBuffers[currentImage], currentImage);
+		}
+
+		gpuProfiler.WriteTimestamp(commandBuffers[currentImage], currentImage, GpuProfiler::CULL_END,
+		                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
 		// begin render pass
-		vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassBeginInfo, geometryContents);
 		{
-			// bind pipeline to be used in render pass
-			vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+			if (recordInParallel)
+			{
+				// geometry timestamps are written by the first and last secondary command buffer
+				RecordSecondaryCommands(currentImage);
 
-			for (auto& thisModel : modelList)
+				vkCmdExecuteCommands(commandBuffers[currentImage],
+				                     static_cast<uint32_t>(secondaryCommandBuffers[currentImage].size()),
+				                     secondaryCommandBuffers[currentImage].data());
+			}
+			else
 			{
-				vkCmdPushConstants(commandBuffers[currentImage], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-				                   sizeof(Model), thisModel.GetModelPtr());
+				gpuProfiler.WriteTimestamp(commandBuffers[currentImage], currentImage, GpuProfiler::GEOMETRY_BEGIN,
+				                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 
-				for (size_t j = 0; j < thisModel.GetMeshCount(); ++j)
+				if (indirectDrawing)
 				{
-					auto* thisMesh = thisModel.GetMesh(j);
-
-					VkBuffer vertexBuffers[] = {thisMesh->GetVertexBuffer()}; // buffers to bind
-					VkDeviceSize offsets[] = {0}; // offsets into buffers being bound
-					vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets);
-					// command to bind vertex buffer before
-					//drawing with them
-
-					// Bind mesh index buffer, with 0 offset and using uint32 type
-					vkCmdBindIndexBuffer(commandBuffers[currentImage], thisMesh->GetIndexBuffer(), 0,
-					                     VK_INDEX_TYPE_UINT32);
-
-					// Dynamic offset Amount
-					//uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * i;
-
-
-					std::array<VkDescriptorSet, 2> descriptorSetGroup = {
-						descriptorSets[currentImage], samplerDescriptorSets[thisMesh->GetTexId()]
-					};
-
-					// Bind Descriptor Sets
-					vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS,
-					                        pipelineLayout,
-					                        0, static_cast<uint32_t>(descriptorSetGroup.size()),
-					                        descriptorSetGroup.data(), 0, nullptr);
-
-					// execute pipeline
-					vkCmdDrawIndexed(commandBuffers[currentImage], thisMesh->GetIndexCount(), 1, 0, 0, 0);
+					RecordIndirectGeometry(commandBuffers[currentImage], currentImage, lastBindStats);
+				}
+				else
+				{
+					RecordGeometry(commandBuffers[currentImage], currentImage, 0, drawList.GetCount(), lastBindStats);
 				}
+
+				gpuProfiler.WriteTimestamp(commandBuffers[currentImage], currentImage, GpuProfiler::GEOMETRY_END,
+				                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 			}
 
 			// Start second subPass
@@ -1322,97 +2170,615 @@ void VulkanRenderer::RecordCommands(const uint32_t currentImage)
 
 				vkCmdDraw(commandBuffers[currentImage], 3, 1, 0, 0);
 			}
+
+			gpuProfiler.WriteTimestamp(commandBuffers[currentImage], currentImage, GpuProfiler::COMPOSITE_END,
+			                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 		}
 		vkCmdEndRenderPass(commandBuffers[currentImage]); // end render pass
+
+		gpuProfiler.WriteTimestamp(commandBuffers[currentImage], currentImage, GpuProfiler::COMMAND_BUFFER_END,
+		                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 	}
 	// end command buffer
 	VK_ERROR(vkEndCommandBuffer(commandBuffers[currentImage]), "Failed to stop recording a command buffer");
 }
 
-void VulkanRenderer::UpdateUniformBuffers(const uint32_t imageIndex)
+void VulkanRenderer::RecordSecondaryCommands(const uint32_t currentImage)
 {
-	// Copy VP Data	
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex], 0, sizeof(UboViewProjection), 0, &data);
+	const size_t chunkCount = secondaryCommandBuffers[currentImage].size();
+	const size_t drawCount = drawList.GetCount();
+	const size_t drawsPerChunk = (drawCount + chunkCount - 1) / chunkCount;
 
-	memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
+	// Secondary command buffers continue the geometry subpass of this image's framebuffer
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = swapChainFramebuffers[currentImage];
 
-	vkUnmapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex]);
-}
+	VkCommandBufferBeginInfo bufferBeginInfo = {};
+	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-void VulkanRenderer::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
-{
-	createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-	createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-		VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-	createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-		VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-	createInfo.pfnUserCallback = DebugCallback;
-	createInfo.pUserData = nullptr; // optional
-}
+	std::vector<std::future<void>> recordedChunks;
+	recordedChunks.reserve(chunkCount);
 
-void VulkanRenderer::SetupDebugMessenger()
-{
-	if (!enableValidationLayers) return;
+	// Each chunk counts its own binds, they are added up once all are recorded
+	std::vector<BindStats> chunkBindStats(chunkCount);
 
-	VkDebugUtilsMessengerCreateInfoEXT createInfo;
-	PopulateDebugMessengerCreateInfo(createInfo);
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		const size_t firstDraw = std::min(chunk * drawsPerChunk, drawCount);
+		const size_t endDraw = std::min(firstDraw + drawsPerChunk, drawCount);
 
-	VK_ERROR(CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger),
-	         "Failed to set up debug messenger");
-}
+		recordedChunks.push_back(recordingThreads->Enqueue([=, &bufferBeginInfo, &chunkBindStats]()
+		{
+			const VkCommandBuffer commandBuffer = secondaryCommandBuffers[currentImage][chunk];
 
-VkResult VulkanRenderer::CreateDebugUtilsMessengerEXT(VkInstance instance,
-                                                      const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
-                                                      const VkAllocationCallbacks* pAllocator,
-                                                      VkDebugUtilsMessengerEXT* pDebugMessenger)
-{
-	const auto func = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(
-		instance, "vkCreateDebugUtilsMessengerEXT"));
-	if (func != nullptr)
-	{
-		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+			VK_ERROR(vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo),
+			         "Failed to start recording a secondary command buffer");
+			{
+				if (chunk == 0)
+				{
+					gpuProfiler.WriteTimestamp(commandBuffer, currentImage, GpuProfiler::GEOMETRY_BEGIN,
+					                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+				}
+
+				RecordGeometry(commandBuffer, currentImage, firstDraw, endDraw, chunkBindStats[chunk]);
+
+				if (chunk == chunkCount - 1)
+				{
+					gpuProfiler.WriteTimestamp(commandBuffer, currentImage, GpuProfiler::GEOMETRY_END,
+					                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+				}
+			}
+			VK_ERROR(vkEndCommandBuffer(commandBuffer), "Failed to stop recording a secondary command buffer");
+		}));
 	}
-	else
+
+	// Wait for every chunk (rethrows any recording error here)
+	for (auto& recordedChunk : recordedChunks)
 	{
-		return VK_ERROR_EXTENSION_NOT_PRESENT;
+		recordedChunk.get();
 	}
-}
 
-void VulkanRenderer::DestroyDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerEXT debugMessenger,
-                                                   const VkAllocationCallbacks* pAllocator)
-{
-	const auto func = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(
-		instance, "vkDestroyDebugUtilsMessengerEXT"));
-	if (func != nullptr)
+	for (const auto& stats : chunkBindStats)
 	{
-		func(instance, debugMessenger, pAllocator);
+		lastBindStats += stats;
 	}
 }
 
-void VulkanRenderer::GetPhysicalDevice()
+void VulkanRenderer::RecordGeometry(VkCommandBuffer commandBuffer, const uint32_t currentImage, const size_t firstDraw,
+                                    const size_t endDraw, BindStats& bindStats)
 {
-	// Enumerate the Physical devices the VkInstance can access
-	uint32_t deviceCount = 0;
-	VK_ERROR(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr), "Failed to get physical device count");
+	// bind pipeline to be used in render pass
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	VkPipeline boundPipeline = graphicsPipeline;
 
-	// if no devices available, then none support Vulkan
-	if (deviceCount == 0)
-	{
-		VK_ERROR(-1, "Can't Find any physical devices that support Vulkan Instance");
-	}
+	// Every texture is in one array, bound once for all draws
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1,
+	                        &samplerDescriptorSets[currentImage], 0, nullptr);
 
-	// get list of physical devices
-	std::vector<VkPhysicalDevice> deviceList(deviceCount);
-	VK_ERROR(vkEnumeratePhysicalDevices(instance, &deviceCount, deviceList.data()),
-	         "Failed to get list of physical devices");
+	// Instance transforms stay bound to the second binding, only the instance pipeline reads them
+	VkDeviceSize instanceOffset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffers[currentImage], &instanceOffset);
 
-	for (const auto& device : deviceList)
+	++bindStats.pipelineBinds;
+	++bindStats.descriptorSetBinds;
+
+	// Only state that differs from the previous draw is bound (draws sorted by key rarely change any)
+	uint32_t boundBufferIndex = UINT32_MAX;
+	uint32_t boundModel = UINT32_MAX;
+	int boundTexId = -1;
+
+	// Only the list's [firstDraw, endDraw) are recorded here
+	const auto& items = drawList.GetItems();
+	for (size_t d = firstDraw; d < endDraw; ++d)
 	{
-		if (CheckDeviceSuitable(device))
+		const DrawItem& item = items[d];
+		auto* thisMesh = modelList[item.modelIndex].GetMesh(item.meshIndex);
+
+		// Both pipelines share a layout, so descriptor sets stay bound across the switch
+		const bool instanced = !modelInstances[item.modelIndex].empty();
+		const VkPipeline meshPipeline = instanced ? instancePipeline : graphicsPipeline;
+		if (meshPipeline != boundPipeline)
 		{
-			mainDevice.physicalDevice = device;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+			boundPipeline = meshPipeline;
+			++bindStats.pipelineBinds;
+		}
+
+		// Meshes share a few big buffers, so they are only bound when the next mesh lives in another one
+		if (thisMesh->GetBufferIndex() != boundBufferIndex)
+		{
+			VkBuffer vertexBuffers[] = {thisMesh->GetVertexBuffer()}; // buffers to bind
+			VkDeviceSize offsets[] = {0}; // offsets into buffers being bound
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+			// command to bind vertex buffer before
+			//drawing with them
+
+			// Bind shared index buffer, with 0 offset and using uint32 type
+			vkCmdBindIndexBuffer(commandBuffer, thisMesh->GetIndexBuffer(), 0,
+			                     VK_INDEX_TYPE_UINT32);
+
+			boundBufferIndex = thisMesh->GetBufferIndex();
+			++bindStats.bufferBinds;
+		}
+
+		// Model data only changes between models
+		if (item.modelIndex != boundModel)
+		{
+			// Dynamic offset Amount
+			const uint32_t dynamicOffset = modelUniformOffsets[item.modelIndex];
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+			                        &descriptorSets[currentImage], 1, &dynamicOffset);
+
+			boundModel = item.modelIndex;
+			++bindStats.descriptorSetBinds;
+		}
+
+		const int texId = thisMesh->GetTexId();
+		if (texId != boundTexId)
+		{
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &texId);
+			boundTexId = texId;
+			++bindStats.textureChanges;
+		}
+
+		// execute pipeline, at the mesh's ranges of the shared buffers (once for every instance)
+		vkCmdDrawIndexed(commandBuffer, thisMesh->GetIndexCount(), GetDrawInstanceCount(item.modelIndex),
+		                 thisMesh->GetFirstIndex(), static_cast<int32_t>(thisMesh->GetVertexOffset()),
+		                 instanced ? modelFirstInstances[item.modelIndex] : 0);
+		++bindStats.draws;
+	}
+}
+
+void VulkanRenderer::RecordIndirectGeometry(VkCommandBuffer commandBuffer, const uint32_t currentImage,
+                                            BindStats& bindStats)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipeline);
+
+	// View projection, model array and textures are the same for every batch
+	std::array<VkDescriptorSet, 2> descriptorSetGroup = {
+		indirectDescriptorSets[currentImage], samplerDescriptorSets[currentImage]
+	};
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipelineLayout, 0,
+	                        static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+
+	++bindStats.pipelineBinds;
+	++bindStats.descriptorSetBinds;
+
+	uint32_t boundBufferIndex = UINT32_MAX;
+	int boundTexId = -1;
+
+	const uint32_t commandStride = sizeof(VkDrawIndexedIndirectCommand);
+
+	for (const auto& batch : indirectBatches)
+	{
+		if (batch.bufferIndex != boundBufferIndex)
+		{
+			VkBuffer vertexBuffers[] = {geometryPool->GetVertexBuffer(batch.bufferIndex)};
+			VkDeviceSize offsets[] = {0};
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, geometryPool->GetIndexBuffer(batch.bufferIndex), 0,
+			                     VK_INDEX_TYPE_UINT32);
+
+			boundBufferIndex = batch.bufferIndex;
+			++bindStats.bufferBinds;
+		}
+
+		if (batch.texId != boundTexId)
+		{
+			vkCmdPushConstants(commandBuffer, indirectPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int),
+			                   &batch.texId);
+			++bindStats.textureChanges;
+
+			boundTexId = batch.texId;
+		}
+
+		const VkDeviceSize batchOffset = static_cast<VkDeviceSize>(batch.firstCommand) * commandStride;
+
+		if (multiDrawIndirectSupported)
+		{
+			// One call draws every mesh of the batch
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandBuffers[currentImage], batchOffset,
+			                         batch.commandCount, commandStride);
+			++bindStats.draws;
+		}
+		else
+		{
+			for (uint32_t i = 0; i < batch.commandCount; ++i)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandBuffers[currentImage],
+				                         batchOffset + static_cast<VkDeviceSize>(i) * commandStride, 1, commandStride);
+			}
+			bindStats.draws += batch.commandCount;
+		}
+	}
+}
+
+void VulkanRenderer::RecordCulling(VkCommandBuffer commandBuffer, const uint32_t currentImage)
+{
+	const uint32_t drawCount = static_cast<uint32_t>(indirectDraws.size());
+	if (drawCount == 0) return;
+
+	// Culled draws leave zeroed (no instance) commands behind, and each batch counts up from zero
+	vkCmdFillBuffer(commandBuffer, indirectCommandBuffers[currentImage], 0,
+	                sizeof(VkDrawIndexedIndirectCommand) * drawCount, 0);
+	vkCmdFillBuffer(commandBuffer, batchCountBuffers[currentImage], 0, sizeof(uint32_t) * indirectBatches.size(), 0);
+
+	VkMemoryBarrier fillBarrier = {};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+	                     1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1,
+	                        &cullDescriptorSets[currentImage], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t),
+	                   &drawCount);
+
+	// 64 draws per work group, to match the shader
+	vkCmdDispatch(commandBuffer, (drawCount + 63) / 64, 1, 1);
+
+	// Draws have to wait for the commands to be written
+	VkMemoryBarrier cullBarrier = {};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+	                     1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanRenderer::BuildDrawList()
+{
+	drawList.Clear();
+
+	uint32_t drawIndex = 0;
+	for (uint32_t i = 0; i < modelList.size(); ++i)
+	{
+		auto& model = modelList[i];
+		const bool instanced = !modelInstances[i].empty();
+
+		for (uint32_t j = 0; j < model.GetMeshCount(); ++j, ++drawIndex)
+		{
+			if (cpuCulling && !drawVisible[drawIndex]) continue;
+
+			if (!sortDraws)
+			{
+				drawList.Add(0, i, j, drawIndex);
+				continue;
+			}
+
+			const Mesh* mesh = model.GetMesh(j);
+
+			// Camera distance of the mesh's box centre, so nearer meshes are drawn first within a state group
+			const glm::vec3 localCentre = (mesh->GetBoundsMax() + mesh->GetBoundsMin()) * 0.5f;
+			const glm::vec4 viewCentre = uboViewProjection.view * model.GetModel() * glm::vec4(localCentre, 1.0f);
+
+			const uint64_t key = DrawList::MakeKey(instanced ? 1 : 0, mesh->GetBufferIndex(),
+			                                       static_cast<uint32_t>(mesh->GetTexId()), -viewCentre.z);
+			drawList.Add(key, i, j, drawIndex);
+		}
+	}
+
+	if (sortDraws)
+	{
+		drawList.Sort();
+	}
+}
+
+void VulkanRenderer::CullDraws()
+{
+	frustumCuller.Resize(GetDrawCount());
+
+	size_t drawIndex = 0;
+	for (size_t modelIndex = 0; modelIndex < modelList.size(); ++modelIndex)
+	{
+		auto& model = modelList[modelIndex];
+		const glm::mat4 transform = model.GetModel();
+		const auto& instances = modelInstances[modelIndex];
+
+		for (size_t i = 0; i < model.GetMeshCount(); ++i, ++drawIndex)
+		{
+			const Mesh* mesh = model.GetMesh(i);
+
+			if (instances.empty())
+			{
+				frustumCuller.SetBox(drawIndex, mesh->GetBoundsMin(), mesh->GetBoundsMax(), transform);
+				continue;
+			}
+
+			// Instanced meshes are one draw, so test a box around every instance's box
+			const glm::vec3 localCentre = (mesh->GetBoundsMax() + mesh->GetBoundsMin()) * 0.5f;
+			const glm::vec3 localExtent = (mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f;
+
+			glm::vec3 boundsMin(std::numeric_limits<float>::max());
+			glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+			for (const auto& instanceMatrix : instances)
+			{
+				const glm::mat4 instanceTransform = transform * instanceMatrix;
+				const glm::vec3 centre = glm::vec3(instanceTransform * glm::vec4(localCentre, 1.0f));
+				const glm::vec3 extent = glm::abs(glm::vec3(instanceTransform[0])) * localExtent.x +
+					glm::abs(glm::vec3(instanceTransform[1])) * localExtent.y +
+					glm::abs(glm::vec3(instanceTransform[2])) * localExtent.z;
+
+				boundsMin = glm::min(boundsMin, centre - extent);
+				boundsMax = glm::max(boundsMax, centre + extent);
+			}
+
+			frustumCuller.SetBox(drawIndex, boundsMin, boundsMax, glm::mat4(1.0f));
+		}
+	}
+
+	frustumCuller.Cull(uboViewProjection.projection * uboViewProjection.view, drawVisible);
+}
+
+size_t VulkanRenderer::GetDrawCount() const
+{
+	size_t drawCount = 0;
+
+	for (const auto& model : modelList)
+	{
+		drawCount += model.GetMeshCount();
+	}
+
+	return drawCount;
+}
+
+uint32_t VulkanRenderer::GetDrawInstanceCount(const size_t modelIndex) const
+{
+	return modelInstances[modelIndex].empty() ? 1 : static_cast<uint32_t>(modelInstances[modelIndex].size());
+}
+
+void VulkanRenderer::BuildIndirectBatches()
+{
+	indirectDraws.clear();
+	indirectBatches.clear();
+
+	for (uint32_t i = 0; i < modelList.size(); ++i)
+	{
+		for (uint32_t j = 0; j < modelList[i].GetMeshCount(); ++j)
+		{
+			indirectDraws.push_back({i, j, static_cast<uint32_t>(indirectDraws.size())});
+		}
+	}
+
+	// Group meshes that share geometry buffers and texture, so each group is one indirect call
+	std::stable_sort(indirectDraws.begin(), indirectDraws.end(), [this](const MeshDraw& a, const MeshDraw& b)
+	{
+		Mesh* meshA = modelList[a.modelIndex].GetMesh(a.meshIndex);
+		Mesh* meshB = modelList[b.modelIndex].GetMesh(b.meshIndex);
+
+		if (meshA->GetBufferIndex() != meshB->GetBufferIndex())
+			return meshA->GetBufferIndex() < meshB->GetBufferIndex();
+
+		return meshA->GetTexId() < meshB->GetTexId();
+	});
+
+	for (uint32_t i = 0; i < indirectDraws.size(); ++i)
+	{
+		Mesh* mesh = modelList[indirectDraws[i].modelIndex].GetMesh(indirectDraws[i].meshIndex);
+
+		if (indirectBatches.empty() || indirectBatches.back().bufferIndex != mesh->GetBufferIndex() ||
+			indirectBatches.back().texId != mesh->GetTexId())
+		{
+			indirectBatches.push_back({mesh->GetBufferIndex(), mesh->GetTexId(), i, 0});
+		}
+
+		++indirectBatches.back().commandCount;
+	}
+}
+
+void VulkanRenderer::UpdateIndirectCommands(const uint32_t imageIndex)
+{
+	if (indirectDraws.size() > MAX_INDIRECT_DRAWS)
+	{
+		throw std::runtime_error("Too many meshes for the indirect command buffer");
+	}
+
+	// One entry per model, or one per instance of an instanced model
+	glm::mat4* objects = static_cast<glm::mat4*>(objectBufferMemory[imageIndex].mappedData);
+	uint32_t objectCount = 0;
+
+	modelFirstObjects.resize(modelList.size());
+	for (size_t i = 0; i < modelList.size(); ++i)
+	{
+		modelFirstObjects[i] = objectCount;
+
+		// Each entry also undoes the vertex quantization
+		const glm::mat4 dequantize = modelList[i].GetVertexQuantization().GetDequantizeTransform();
+
+		if (modelInstances[i].empty())
+		{
+			objects[objectCount++] = modelList[i].GetModel() * dequantize;
+			continue;
+		}
+
+		for (const auto& instanceMatrix : modelInstances[i])
+		{
+			objects[objectCount++] = modelList[i].GetModel() * instanceMatrix * dequantize;
+		}
+	}
+
+	if (gpuCulling)
+	{
+		// The cull pass writes the commands, it only needs to know what each draw would be
+		auto* cullDraws = static_cast<CullDraw*>(cullDrawBufferMemory[imageIndex].mappedData);
+		for (uint32_t batchIndex = 0; batchIndex < indirectBatches.size(); ++batchIndex)
+		{
+			const IndirectBatch& batch = indirectBatches[batchIndex];
+			for (uint32_t i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; ++i)
+			{
+				MeshModel& model = modelList[indirectDraws[i].modelIndex];
+				Mesh* mesh = model.GetMesh(indirectDraws[i].meshIndex);
+
+				// Tested with the object matrices, so in the same quantized space as the vertices
+				const VertexQuantization& quantization = model.GetVertexQuantization();
+				cullDraws[i].boundsMin = glm::vec4(quantization.Quantize(mesh->GetBoundsMin()), 1.0f);
+				cullDraws[i].boundsMax = glm::vec4(quantization.Quantize(mesh->GetBoundsMax()), 1.0f);
+				cullDraws[i].indexCount = mesh->GetIndexCount();
+				cullDraws[i].firstIndex = mesh->GetFirstIndex();
+				cullDraws[i].vertexOffset = static_cast<int32_t>(mesh->GetVertexOffset());
+				cullDraws[i].firstObject = modelFirstObjects[indirectDraws[i].modelIndex];
+				cullDraws[i].batchFirstCommand = batch.firstCommand;
+				cullDraws[i].batchIndex = batchIndex;
+				cullDraws[i].instanceCount = GetDrawInstanceCount(indirectDraws[i].modelIndex);
+			}
+		}
+		return;
+	}
+
+	auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectCommandBufferMemory[imageIndex].mappedData);
+	for (size_t i = 0; i < indirectDraws.size(); ++i)
+	{
+		Mesh* mesh = modelList[indirectDraws[i].modelIndex].GetMesh(indirectDraws[i].meshIndex);
+
+		commands[i].indexCount = mesh->GetIndexCount();
+		const bool culled = cpuCulling && !drawVisible[indirectDraws[i].drawIndex];
+		commands[i].instanceCount = culled ? 0 : GetDrawInstanceCount(indirectDraws[i].modelIndex);
+		commands[i].firstIndex = mesh->GetFirstIndex();
+		commands[i].vertexOffset = static_cast<int32_t>(mesh->GetVertexOffset());
+		// picks the model matrix (or first instance's) in the shader
+		commands[i].firstInstance = modelFirstObjects[indirectDraws[i].modelIndex];
+	}
+}
+
+void VulkanRenderer::UpdateInstanceBuffer(const uint32_t imageIndex)
+{
+	// Models are packed in order, so the offsets only change when instances are added
+	auto* instanceData = static_cast<glm::mat4*>(instanceBufferMemory[imageIndex].mappedData);
+	uint32_t instanceCount = 0;
+
+	modelFirstInstances.resize(modelList.size());
+	for (size_t i = 0; i < modelList.size(); ++i)
+	{
+		modelFirstInstances[i] = instanceCount;
+
+		// Innermost transform, so the vertex quantization is undone here
+		const glm::mat4 dequantize = modelList[i].GetVertexQuantization().GetDequantizeTransform();
+		for (const auto& instanceMatrix : modelInstances[i])
+		{
+			instanceData[instanceCount++] = instanceMatrix * dequantize;
+		}
+	}
+}
+
+void VulkanRenderer::UpdateUniformBuffers(const uint32_t imageIndex)
+{
+	// Copy VP Data	
+	*vpUniformBufferMapped[imageIndex] = uboViewProjection;
+
+	// Copy Model Data into this image's region of the ring
+	modelUniformRing.BeginFrame(imageIndex);
+	modelUniformOffsets.resize(modelList.size());
+
+	for (size_t i = 0; i < modelList.size(); ++i)
+	{
+		UboModel* uboModel = modelUniformRing.Allocate<UboModel>(&modelUniformOffsets[i]);
+
+		// Instanced models undo the vertex quantization in their instance transforms instead
+		uboModel->model = modelList[i].GetModel();
+		if (modelInstances[i].empty())
+		{
+			uboModel->model *= modelList[i].GetVertexQuantization().GetDequantizeTransform();
+		}
+	}
+
+	if (indirectDrawing)
+	{
+		UpdateIndirectCommands(imageIndex);
+	}
+	else
+	{
+		UpdateInstanceBuffer(imageIndex);
+	}
+}
+
+void VulkanRenderer::MarkCommandBuffersDirty()
+{
+	std::fill(commandBufferDirty.begin(), commandBufferDirty.end(), true);
+}
+
+void VulkanRenderer::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
+{
+	createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+	createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+		VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+		VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+	createInfo.pfnUserCallback = DebugCallback;
+	createInfo.pUserData = nullptr; // optional
+}
+
+void VulkanRenderer::SetupDebugMessenger()
+{
+	if (!enableValidationLayers) return;
+
+	VkDebugUtilsMessengerCreateInfoEXT createInfo;
+	PopulateDebugMessengerCreateInfo(createInfo);
+
+	VK_ERROR(CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger),
+	         "Failed to set up debug messenger");
+}
+
+VkResult VulkanRenderer::CreateDebugUtilsMessengerEXT(VkInstance instance,
+                                                      const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
+                                                      const VkAllocationCallbacks* pAllocator,
+                                                      VkDebugUtilsMessengerEXT* pDebugMessenger)
+{
+	const auto func = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(
+		instance, "vkCreateDebugUtilsMessengerEXT"));
+	if (func != nullptr)
+	{
+		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+	}
+	else
+	{
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+}
+
+void VulkanRenderer::DestroyDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerEXT debugMessenger,
+                                                   const VkAllocationCallbacks* pAllocator)
+{
+	const auto func = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(
+		instance, "vkDestroyDebugUtilsMessengerEXT"));
+	if (func != nullptr)
+	{
+		func(instance, debugMessenger, pAllocator);
+	}
+}
+
+void VulkanRenderer::GetPhysicalDevice()
+{
+	// Enumerate the Physical devices the VkInstance can access
+	uint32_t deviceCount = 0;
+	VK_ERROR(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr), "Failed to get physical device count");
+
+	// if no devices available, then none support Vulkan
+	if (deviceCount == 0)
+	{
+		VK_ERROR(-1, "Can't Find any physical devices that support Vulkan Instance");
+	}
+
+	// get list of physical devices
+	std::vector<VkPhysicalDevice> deviceList(deviceCount);
+	VK_ERROR(vkEnumeratePhysicalDevices(instance, &deviceCount, deviceList.data()),
+	         "Failed to get list of physical devices");
+
+	for (const auto& device : deviceList)
+	{
+		if (CheckDeviceSuitable(device))
+		{
+			mainDevice.physicalDevice = device;
 			break;
 		}
 	}
@@ -1500,6 +2866,13 @@ bool VulkanRenderer::CheckDeviceSuitable(const VkPhysicalDevice device)
 
 	const QueueFamilyIndices indices = GetQueueFamilies(device);
 
+	// without a surface there is no swap chain to check for
+	if (headless)
+	{
+		return indices.IsValid() && deviceFeatures.samplerAnisotropy &&
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing;
+	}
+
 	const bool extensionsSupported = CheckDeviceExtensionSupport(device);
 
 	bool swapChainValid = false;
@@ -1510,7 +2883,8 @@ bool VulkanRenderer::CheckDeviceSuitable(const VkPhysicalDevice device)
 		swapChainValid = !swapChainDetails.presentationModes.empty() && !swapChainDetails.formats.empty();
 	}
 
-	return indices.IsValid() && extensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy;
+	return indices.IsValid() && extensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy &&
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing;
 }
 
 bool VulkanRenderer::CheckValidationLayerSupport() const
@@ -1574,9 +2948,17 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(const VkPhysicalDevice devic
 		}
 
 		// check if queue family supports presentation
+		// (nothing is presented when headless, so the graphics queue stands in for presentation)
 		VkBool32 presentationSupport = false;
-		VK_ERROR(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport),
-		         "Failed to check physical device surface support");
+		if (headless)
+		{
+			presentationSupport = indices.graphicsFamily == i;
+		}
+		else
+		{
+			VK_ERROR(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport),
+			         "Failed to check physical device surface support");
+		}
 
 		// check if queue is presentation type (can be both graphics and presentation)
 		if (queueFamily.queueCount > 0 && presentationSupport)
@@ -1591,18 +2973,45 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(const VkPhysicalDevice devic
 		++i;
 	}
 
+	// Uploads go to a family that only does transfers if there is one (these are usually separate DMA engines),
+	// otherwise to one without graphics, otherwise to the graphics family itself
+	int bestTransferScore = 0;
+	indices.transferFamily = indices.graphicsFamily;
+	for (int family = 0; family < static_cast<int>(queueFamilyList.size()); ++family)
+	{
+		const VkQueueFlags flags = queueFamilyList[family].queueFlags;
+		if (queueFamilyList[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) ||
+			flags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			continue;
+		}
+
+		const int transferScore = flags & VK_QUEUE_COMPUTE_BIT ? 1 : 2;
+		if (transferScore > bestTransferScore)
+		{
+			bestTransferScore = transferScore;
+			indices.transferFamily = family;
+		}
+	}
+
 	return indices;
 }
 
-std::vector<const char*> VulkanRenderer::GetRequiredGLFWExtensions() const
+std::vector<const char*> VulkanRenderer::GetRequiredInstanceExtensions() const
 {
-	// Set up extensions that the instance will use
-	uint32_t glfwExtensionCount = 0; // GLFW may require multiple extensions
+	std::vector<const char*> extensions;
 
-	// Extensions passed as array of c-strings, so this is the pointer to the array or pointers
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	// Surface extensions are only needed when rendering to a window
+	if (!headless)
+	{
+		// Set up extensions that the instance will use
+		uint32_t glfwExtensionCount = 0; // GLFW may require multiple extensions
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		// Extensions passed as array of c-strings, so this is the pointer to the array or pointers
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers)
 	{
@@ -1735,7 +3144,7 @@ VkFormat VulkanRenderer::ChooseSupportedFormat(const std::vector<VkFormat>& form
 
 VkImage VulkanRenderer::CreateImage(const uint32_t width, const uint32_t height, const VkFormat format, const VkImageTiling tiling,
                                     const VkImageUsageFlags usageFlags, const VkMemoryPropertyFlags propFlags,
-                                    VkDeviceMemory* imageMemory) const
+                                    MemoryAllocation* imageMemory, const uint32_t mipLevels)
 {
 	// -- Create Image --
 	VkImageCreateInfo imageCreateInfo = {};
@@ -1744,7 +3153,7 @@ VkImage VulkanRenderer::CreateImage(const uint32_t width, const uint32_t height,
 	imageCreateInfo.extent.width = width;
 	imageCreateInfo.extent.height = height;
 	imageCreateInfo.extent.depth = 1;
-	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.mipLevels = mipLevels;
 	imageCreateInfo.arrayLayers = 1;
 	imageCreateInfo.format = format;
 	imageCreateInfo.tiling = tiling; // How image data should be arranged for reading
@@ -1760,24 +3169,17 @@ VkImage VulkanRenderer::CreateImage(const uint32_t width, const uint32_t height,
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(mainDevice.logicalDevice, image, &memRequirements);
 
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = FindMemoryTypeIndex(mainDevice.physicalDevice, memRequirements.memoryTypeBits,
-	                                                         propFlags);
-
-	VK_ERROR(vkAllocateMemory(mainDevice.logicalDevice, &memoryAllocateInfo, nullptr, imageMemory),
-	         "Failed to allocate memory for image");
+	*imageMemory = memoryAllocator->Allocate(memRequirements, propFlags);
 
 	// connect memory to image
-	VK_ERROR(vkBindImageMemory(mainDevice.logicalDevice, image, *imageMemory, 0),
+	VK_ERROR(vkBindImageMemory(mainDevice.logicalDevice, image, imageMemory->memory, imageMemory->offset),
 	         "Failed to bind image to allocated memory");
 
 	return image;
 }
 
 VkImageView VulkanRenderer::CreateImageView(const VkImage image, const VkFormat format,
-                                            const VkImageAspectFlags aspectFlags) const
+                                            const VkImageAspectFlags aspectFlags, const uint32_t mipLevels) const
 {
 	VkImageViewCreateInfo viewCreateInfo = {};
 	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1792,7 +3194,7 @@ VkImageView VulkanRenderer::CreateImageView(const VkImage image, const VkFormat
 	// Subresources allow the view to view only a part of an image
 	viewCreateInfo.subresourceRange.aspectMask = aspectFlags;
 	viewCreateInfo.subresourceRange.baseMipLevel = 0;
-	viewCreateInfo.subresourceRange.levelCount = 1;
+	viewCreateInfo.subresourceRange.levelCount = mipLevels;
 	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
 	viewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -1818,142 +3220,707 @@ VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& shade
 	return shaderModule;
 }
 
-int VulkanRenderer::CreateTextureImage(const std::string& fileName)
+VkImage VulkanRenderer::CreateTextureImage(const DecodedTexture& texture, MemoryAllocation* imageMemory)
 {
-	int width, height;
-	VkDeviceSize imageSize;
-	stbi_uc* imageData = LoadTextureFile(fileName, width, height, &imageSize);
+	const uint32_t width = static_cast<uint32_t>(texture.width);
+	const uint32_t height = static_cast<uint32_t>(texture.height);
+	const uint32_t fileLevels = static_cast<uint32_t>(texture.levels.size());
+
+	// Single level images (anything decoded by stb) get the rest of their chain generated on the device
+	const bool generateMipmaps = fileLevels == 1 && texture.format == VK_FORMAT_R8G8B8A8_UNORM &&
+		mipmapGenerationSupported;
+	uint32_t mipLevels = fileLevels;
+	if (generateMipmaps)
+	{
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		{
+			++mipLevels;
+		}
+	}
 
-	// Create staging buffer to hold loaded data, ready to copy to device
-	VkBuffer imageStagingBuffer;
-	VkDeviceMemory imageStagingBufferMemory;
-	CreateBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &imageStagingBuffer,
-	             &imageStagingBufferMemory);
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, imageData, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mainDevice.logicalDevice, imageStagingBufferMemory);
+	// Each level is copied from its own offset, which has to be a multiple of the block size
+	const VkDeviceSize levelAlignment = 16;
+	VkDeviceSize stagingSize = 0;
+	for (const auto& level : texture.levels)
+	{
+		stagingSize += (level.size + levelAlignment - 1) & ~(levelAlignment - 1);
+	}
 
-	// free original image data
-	stbi_image_free(imageData);
+	// Stage loaded data in the upload ring, ready to copy to device
+	const StagingAllocation imageStaging = uploadQueue.AllocateStaging(stagingSize, levelAlignment);
 
-	VkDeviceMemory texImageMemory;
-	const VkImage texImage = CreateImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-	                                     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-	                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texImageMemory);
+	std::vector<VkBufferImageCopy> levelRegions(fileLevels);
+	VkDeviceSize stagingOffset = 0;
+	for (uint32_t i = 0; i < fileLevels; ++i)
+	{
+		const TextureLevel& level = texture.levels[i];
+		memcpy(static_cast<uint8_t*>(imageStaging.data) + stagingOffset, texture.data + level.offset,
+		       static_cast<size_t>(level.size));
+
+		VkBufferImageCopy& region = levelRegions[i];
+		region = {};
+		region.bufferOffset = imageStaging.offset + stagingOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = i;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = {level.width, level.height, 1};
+
+		stagingOffset += (level.size + levelAlignment - 1) & ~(levelAlignment - 1);
+	}
 
-	// Transition image to be DST for copy operation
-	TransitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage,
-	                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (generateMipmaps)
+	{
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // each level is blitted from the one above
+	}
 
-	// Copy data to image
-	CopyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStagingBuffer, texImage, width,
-	                height);
+	const VkImage texImage = CreateImage(width, height, texture.format, VK_IMAGE_TILING_OPTIMAL, usage,
+	                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageMemory, mipLevels);
 
-	TransitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage,
-	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Copy data to image on the transfer queue, then hand it to graphics ready to be sampled
+	const VkCommandBuffer transferCommandBuffer = uploadQueue.Record();
+	{
+		// Transition image to be DST for copy operation
+		TransitionImageLayout(transferCommandBuffer, texImage, VK_IMAGE_LAYOUT_UNDEFINED,
+		                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-	textureImages.push_back(texImage);
-	textureImageMemory.push_back(texImageMemory);
+		// Every level in the file in one copy
+		vkCmdCopyBufferToImage(transferCommandBuffer, imageStaging.buffer, texImage,
+		                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, fileLevels, levelRegions.data());
 
-	// Destroy staging buffers
-	vkDestroyBuffer(mainDevice.logicalDevice, imageStagingBuffer, nullptr);
-	vkFreeMemory(mainDevice.logicalDevice, imageStagingBufferMemory, nullptr);
+		if (generateMipmaps)
+		{
+			uploadQueue.ReleaseImageWithMipmaps(transferCommandBuffer, texImage, width, height, mipLevels,
+			                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		else
+		{
+			uploadQueue.ReleaseImage(transferCommandBuffer, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			                         VK_ACCESS_SHADER_READ_BIT);
+		}
+	}
 
-	return textureImages.size() - 1; // index of new textured image
+	return texImage;
 }
 
 int VulkanRenderer::CreateTexture(const std::string& fileName)
 {
-	const int textureImageLocation = CreateTextureImage(fileName);
+	return CreateTexture(fileName, LoadTextureFile(fileName));
+}
+
+int VulkanRenderer::CreateTexture(const std::string& fileName, const DecodedTexture& texture)
+{
+	// Same file as a texture that already exists, share it instead of uploading it again
+	const int cachedTextureId = textureCache.Acquire(texture.key);
+	if (cachedTextureId >= 0)
+	{
+		stbi_image_free(texture.pixels);
+		return cachedTextureId;
+	}
+
+	// Was cached when it was loaded (so nothing was read), but has been destroyed since
+	if (texture.levels.empty())
+	{
+		return CreateTexture(fileName, LoadTextureFile(fileName));
+	}
 
-	const VkImageView imageView = CreateImageView(textureImages[textureImageLocation], VK_FORMAT_R8G8B8A8_UNORM,
-	                                              VK_IMAGE_ASPECT_COLOR_BIT);
-	textureImageViews.push_back(imageView);
+	if (freeTextureIds.empty() && textureImageViews.size() >= textureArraySize)
+	{
+		stbi_image_free(texture.pixels);
+		throw std::runtime_error("Failed to create texture, too many textures! (" + fileName + ")");
+	}
 
-	const int descriptorLocation = CreateTextureDescriptor(imageView);
+	MemoryAllocation texImageMemory;
+	const VkImage texImage = CreateTextureImage(texture, &texImageMemory);
+
+	// free original image data
+	stbi_image_free(texture.pixels);
 
-	return descriptorLocation;
+	// View covers generated levels as well as the ones in the file
+	const VkImageView imageView = CreateImageView(texImage, texture.format, VK_IMAGE_ASPECT_COLOR_BIT,
+	                                              VK_REMAINING_MIP_LEVELS);
+
+	// Gaps left by destroyed textures are filled first
+	int textureId;
+	if (!freeTextureIds.empty())
+	{
+		textureId = freeTextureIds.back();
+		freeTextureIds.pop_back();
+
+		textureImages[textureId] = texImage;
+		textureImageMemory[textureId] = texImageMemory;
+		textureImageViews[textureId] = imageView;
+	}
+	else
+	{
+		textureImages.push_back(texImage);
+		textureImageMemory.push_back(texImageMemory);
+		textureImageViews.push_back(imageView);
+		textureId = static_cast<int>(textureImageViews.size() - 1);
+	}
+
+	textureCache.Add(texture.key, textureId);
+
+	// Written into each image's texture array before that image is next recorded
+	for (auto& descriptorWrites : textureDescriptorWrites)
+	{
+		descriptorWrites.push_back(static_cast<uint32_t>(textureId));
+	}
+
+	return textureId;
+}
+
+void VulkanRenderer::ReleaseTexture(const int textureId)
+{
+	if (textureCache.Release(textureId))
+	{
+		DestroyTexture(textureId);
+	}
 }
 
-int VulkanRenderer::CreateTextureDescriptor(const VkImageView textureImage)
+void VulkanRenderer::DestroyTexture(const int textureId)
 {
-	VkDescriptorSet descriptorSet;
+	vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[textureId], nullptr);
+	vkDestroyImage(mainDevice.logicalDevice, textureImages[textureId], nullptr);
+	memoryAllocator->Free(textureImageMemory[textureId]);
 
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = samplerDescriptorPool;
-	setAllocInfo.descriptorSetCount = 1;
-	setAllocInfo.pSetLayouts = &samplerSetLayout;
+	textureImageViews[textureId] = VK_NULL_HANDLE;
+	textureImages[textureId] = VK_NULL_HANDLE;
+	textureImageMemory[textureId] = {};
+	freeTextureIds.push_back(textureId);
 
-	// allocate descriptor sets
-	VK_ERROR(vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, &descriptorSet),
-	         "Failed to allocate texture descriptor sets");
+	// Slot points at the default texture again until it's reused
+	for (auto& descriptorWrites : textureDescriptorWrites)
+	{
+		descriptorWrites.push_back(static_cast<uint32_t>(textureId));
+	}
+}
+
+void VulkanRenderer::UpdateTextureDescriptors(const uint32_t imageIndex)
+{
+	std::vector<uint32_t>& descriptorWrites = textureDescriptorWrites[imageIndex];
+	if (descriptorWrites.empty() || textureImageViews.empty()) return;
+
+	std::sort(descriptorWrites.begin(), descriptorWrites.end());
+	descriptorWrites.erase(std::unique(descriptorWrites.begin(), descriptorWrites.end()), descriptorWrites.end());
+
+	// Empty slots get the default texture, the shader can read any of them
+	std::vector<VkDescriptorImageInfo> imageInfos(descriptorWrites.size());
+	for (size_t i = 0; i < descriptorWrites.size(); ++i)
+	{
+		const uint32_t slot = descriptorWrites[i];
+		const bool hasTexture = slot < textureImageViews.size() && textureImageViews[slot] != VK_NULL_HANDLE;
+
+		VkDescriptorImageInfo& imageInfo = imageInfos[i];
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = hasTexture ? textureImageViews[slot] : textureImageViews[0];
+		imageInfo.sampler = textureSampler;
+	}
 
-	// Texture image info
-	VkDescriptorImageInfo imageInfo = {};
-	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageInfo.imageView = textureImage;
-	imageInfo.sampler = textureSampler;
+	// One write per run of consecutive slots
+	std::vector<VkWriteDescriptorSet> descriptorSetWrites;
+	for (size_t first = 0; first < descriptorWrites.size();)
+	{
+		size_t end = first + 1;
+		while (end < descriptorWrites.size() && descriptorWrites[end] == descriptorWrites[end - 1] + 1)
+		{
+			++end;
+		}
 
-	// Descriptor write info
-	VkWriteDescriptorSet descriptorWrite = {};
-	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSet;
-	descriptorWrite.dstBinding = 0;
-	descriptorWrite.dstArrayElement = 0;
-	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	descriptorWrite.descriptorCount = 1;
-	descriptorWrite.pImageInfo = &imageInfo;
+		// Descriptor write info
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = samplerDescriptorSets[imageIndex];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = descriptorWrites[first];
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = static_cast<uint32_t>(end - first);
+		descriptorWrite.pImageInfo = &imageInfos[first];
+		descriptorSetWrites.push_back(descriptorWrite);
+
+		first = end;
+	}
 
-	// Update new descriptor set
-	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(descriptorSetWrites.size()),
+	                       descriptorSetWrites.data(), 0, nullptr);
 
-	// Add descriptor set to list
-	samplerDescriptorSets.push_back(descriptorSet);
-	return samplerDescriptorSets.size() - 1;
+	descriptorWrites.clear();
+
+	// Updating the set invalidates anything recorded with it
+	commandBufferDirty[imageIndex] = true;
 }
 
-uint32_t VulkanRenderer::CreateMeshModel(const std::string& modelFile)
+uint32_t VulkanRenderer::CreateModelSlot(const std::string& modelFile)
 {
-	// Import model "scene"
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(
-		modelFile, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
+	if (freeModelIds.empty() && modelList.size() >= MAX_OBJECTS)
+	{
+		throw std::runtime_error("Failed to load model, too many models! (" + modelFile + ")");
+	}
 
-	if (!scene)
+	// Slots of unloaded models are reused before the list grows
+	if (freeModelIds.empty())
 	{
-		throw std::runtime_error("Failed to load model! (" + modelFile + ")");
+		modelList.emplace_back();
+		modelInstances.emplace_back();
+		modelTextures.emplace_back();
+		modelLoadErrors.emplace_back();
+		return static_cast<uint32_t>(modelList.size() - 1);
 	}
 
-	// Vector of all materials with 1:1 Id placement
-	std::vector<std::string> textureNames = MeshModel::LoadMaterials(scene);
+	const uint32_t modelId = freeModelIds.back();
+	freeModelIds.pop_back();
+
+	modelList[modelId] = MeshModel();
+	modelLoadErrors[modelId].clear();
+
+	return modelId;
+}
+
+uint32_t VulkanRenderer::CreateMeshModel(const std::string& modelFile)
+{
+	if (freeModelIds.empty() && modelList.size() >= MAX_OBJECTS)
+	{
+		throw std::runtime_error("Failed to load model, too many models! (" + modelFile + ")");
+	}
+
+	ImportedModel imported = ImportModel(modelFile);
 
 	// Conversion from the materials list IDs to our Descriptor Array IDs
-	std::vector<int> matToTex(textureNames.size());
+	std::vector<int> matToTex(imported.textureNames.size(), 0);
+	std::vector<int> textureIds; // the model holds a reference to each
 
-	// Loop over textureNames and Create textures for them
-	for (size_t i = 0; i < textureNames.size(); ++i)
+	// Load in all of the meshes
+	std::vector<Mesh> modelMeshes;
+	std::vector<uint32_t> meshMaterials;
+	VertexQuantization vertexQuantization;
+
+	try
 	{
-		if (textureNames[i].empty())
+		// Uploads are recorded here, in material order, so texture ids don't depend on which decode finished first
+		for (size_t i = 0; i < imported.textureNames.size(); ++i)
 		{
-			matToTex[i] = 0;
+			if (!imported.decodedTextures[i].valid()) continue;
+
+			matToTex[i] = CreateTexture(imported.textureNames[i], imported.decodedTextures[i].get());
+			textureIds.push_back(matToTex[i]);
+		}
+
+		UploadImportedMeshes(imported, modelMeshes, meshMaterials, &vertexQuantization);
+	}
+	catch (...)
+	{
+		DiscardImport(imported);
+		for (auto& mesh : modelMeshes)
+		{
+			mesh.DestroyMeshBuffers();
+		}
+
+		// Textures it created may still be uploading
+		uploadQueue.WaitAll();
+		for (const int textureId : textureIds)
+		{
+			ReleaseTexture(textureId);
+		}
+		throw;
+	}
+
+	for (size_t i = 0; i < modelMeshes.size(); ++i)
+	{
+		modelMeshes[i].SetTexId(matToTex[meshMaterials[i]]);
+	}
+
+	const uint32_t modelId = CreateModelSlot(modelFile);
+	modelList[modelId] = MeshModel(modelMeshes);
+	modelList[modelId].SetVertexQuantization(vertexQuantization);
+	modelTextures[modelId] = textureIds;
+
+	BuildIndirectBatches();
+
+	// New model needs its draws recorded into every command buffer
+	MarkCommandBuffersDirty();
+
+	return modelId;
+}
+
+uint32_t VulkanRenderer::LoadMeshModelAsync(const std::string& modelFile)
+{
+	// The model exists straight away (so instances can be added), it just has no meshes yet
+	const uint32_t modelId = CreateModelSlot(modelFile);
+
+	StreamingModel streaming;
+	streaming.modelIndex = modelId;
+	streaming.import = loadingThreads->Enqueue([this, modelFile]() { return ImportModel(modelFile); });
+	streamingModels.push_back(std::move(streaming));
+
+	BuildIndirectBatches();
+	MarkCommandBuffersDirty();
+
+	return modelId;
+}
+
+bool VulkanRenderer::IsModelLoaded(const uint32_t modelId) const
+{
+	return GetModelLoadState(modelId) == ModelLoadState::LOADED;
+}
+
+ModelLoadState VulkanRenderer::GetModelLoadState(const uint32_t modelId) const
+{
+	for (const auto& streaming : streamingModels)
+	{
+		if (streaming.modelIndex == modelId) return ModelLoadState::LOADING;
+	}
+
+	if (modelId >= modelList.size() || !modelLoadErrors[modelId].empty()) return ModelLoadState::FAILED;
+	return ModelLoadState::LOADED;
+}
+
+std::string VulkanRenderer::GetModelLoadError(const uint32_t modelId) const
+{
+	if (modelId >= modelLoadErrors.size()) return "No such model";
+	return modelLoadErrors[modelId];
+}
+
+void VulkanRenderer::UnloadMeshModel(const uint32_t modelId)
+{
+	if (modelId >= modelList.size() ||
+		std::find(freeModelIds.begin(), freeModelIds.end(), modelId) != freeModelIds.end()) return;
+
+	// One that's still streaming in stops loading
+	for (auto streaming = streamingModels.begin(); streaming != streamingModels.end(); ++streaming)
+	{
+		if (streaming->modelIndex != modelId) continue;
+
+		DiscardStreamingModel(*streaming);
+		streamingModels.erase(streaming);
+		break;
+	}
+
+	// Its geometry and textures may still be uploading, or be used by frames in flight
+	uploadQueue.WaitAll();
+	VK_ERROR(vkDeviceWaitIdle(mainDevice.logicalDevice), "Failed to wait until the device was idle");
+
+	modelList[modelId].DestroyMeshModel();
+
+	// Textures shared with other models stay until the last of them lets go
+	for (const int textureId : modelTextures[modelId])
+	{
+		ReleaseTexture(textureId);
+	}
+	modelTextures[modelId].clear();
+
+	// Its instances no longer count against MAX_INSTANCES
+	totalInstanceCount -= static_cast<uint32_t>(modelInstances[modelId].size());
+	modelInstances[modelId].clear();
+
+	// The slot is handed to the next model loaded, a failed load's error stays readable until then
+	freeModelIds.push_back(modelId);
+
+	BuildIndirectBatches();
+	MarkCommandBuffersDirty();
+}
+
+ImportedModel VulkanRenderer::ImportModel(const std::string& modelFile) const
+{
+	const unsigned int importerFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices;
+
+	ImportedModel imported;
+	imported.modelFile = modelFile;
+	imported.cacheKey = MeshCache::MakeKey(modelFile, importerFlags);
+
+	// A cooked file of this exact model skips Assimp entirely
+	std::shared_ptr<Assimp::Importer> importer;
+	const aiScene* scene = nullptr;
+
+	auto meshCache = std::make_shared<MeshCache>();
+	if (meshCache->Open(modelFile, imported.cacheKey))
+	{
+		imported.meshCache = meshCache;
+		imported.textureNames = meshCache->GetTextureNames();
+	}
+	else
+	{
+		// Import model "scene", kept alive by the tasks that read it until the last of them has run
+		importer = std::make_shared<Assimp::Importer>();
+		scene = importer->ReadFile(modelFile, importerFlags);
+
+		if (!scene)
+		{
+			throw std::runtime_error("Failed to load model! (" + modelFile + ")");
+		}
+
+		// Vector of all materials with 1:1 Id placement
+		imported.textureNames = MeshModel::LoadMaterials(scene);
+	}
+
+	// Decode every texture and convert every mesh on the loading threads
+	imported.decodedTextures.resize(imported.textureNames.size());
+	for (size_t i = 0; i < imported.textureNames.size(); ++i)
+	{
+		if (imported.textureNames[i].empty()) continue;
+
+		const std::string textureName = imported.textureNames[i];
+		imported.decodedTextures[i] = loadingThreads->Enqueue([this, textureName]()
+		{
+			return LoadTextureFile(textureName);
+		});
+	}
+
+	if (!scene) return imported;
+
+	std::vector<const aiMesh*> sceneMeshes;
+	MeshModel::CollectMeshes(scene->mRootNode, scene, sceneMeshes);
+
+	imported.convertedMeshes.reserve(sceneMeshes.size());
+	for (const aiMesh* mesh : sceneMeshes)
+	{
+		imported.convertedMeshes.push_back(loadingThreads->Enqueue([importer, mesh]()
+		{
+			return MeshModel::ConvertMesh(mesh);
+		}));
+	}
+
+	return imported;
+}
+
+void VulkanRenderer::DiscardImport(ImportedModel& imported)
+{
+	// Decoded pixels that were never uploaded still have to be freed
+	for (auto& decodedTexture : imported.decodedTextures)
+	{
+		if (!decodedTexture.valid()) continue;
+
+		try
+		{
+			stbi_image_free(decodedTexture.get().pixels);
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	for (auto& convertedMesh : imported.convertedMeshes)
+	{
+		if (convertedMesh.valid()) convertedMesh.wait();
+	}
+}
+
+void VulkanRenderer::UploadImportedMeshes(ImportedModel& imported, std::vector<Mesh>& meshes,
+                                          std::vector<uint32_t>& meshMaterials,
+                                          VertexQuantization* vertexQuantization)
+{
+	// Positions of every mesh are packed within the model's box, which the model's matrix then undoes
+	*vertexQuantization = VertexQuantization();
+
+	if (imported.meshCache)
+	{
+		const std::vector<CachedMesh>& cachedMeshes = imported.meshCache->GetMeshes();
+		if (DeviceVertex::QUANTIZED)
+		{
+			*vertexQuantization = VertexQuantization::FromMeshBounds(cachedMeshes);
+		}
+
+		// Straight from the mapping into the staging ring
+		for (const CachedMesh& cachedMesh : cachedMeshes)
+		{
+			meshes.emplace_back(geometryPool.get(), &uploadQueue, cachedMesh.vertices, cachedMesh.vertexCount,
+			                    cachedMesh.indices, cachedMesh.indexCount, cachedMesh.boundsMin, cachedMesh.boundsMax,
+			                    *vertexQuantization, 0);
+			meshMaterials.push_back(cachedMesh.materialIndex);
+		}
+
+		// Everything has been copied out of it
+		imported.meshCache.reset();
+		return;
+	}
+
+	const auto meshData = std::make_shared<std::vector<MeshData>>();
+	meshData->reserve(imported.convertedMeshes.size());
+	for (auto& convertedMesh : imported.convertedMeshes)
+	{
+		meshData->push_back(convertedMesh.get());
+	}
+	imported.convertedMeshes.clear();
+
+	if (DeviceVertex::QUANTIZED)
+	{
+		*vertexQuantization = VertexQuantization::FromMeshBounds(*meshData);
+	}
+
+	for (const MeshData& mesh : *meshData)
+	{
+		meshes.emplace_back(geometryPool.get(), &uploadQueue, mesh.vertices.data(),
+		                    static_cast<uint32_t>(mesh.vertices.size()), mesh.indices.data(),
+		                    static_cast<uint32_t>(mesh.indices.size()), mesh.boundsMin, mesh.boundsMax,
+		                    *vertexQuantization, 0);
+		meshMaterials.push_back(mesh.materialIndex);
+	}
+
+	// Cook the meshes for the next load on a loading thread, if it can't be written the model is just imported again
+	const std::string modelFile = imported.modelFile;
+	const MeshCacheKey cacheKey = imported.cacheKey;
+	const std::vector<std::string> textureNames = imported.textureNames;
+	loadingThreads->Enqueue([modelFile, cacheKey, textureNames, meshData]()
+	{
+		return MeshCache::Write(modelFile, cacheKey, textureNames, *meshData);
+	});
+}
+
+bool VulkanRenderer::UpdateStreamingModel(StreamingModel& streaming)
+{
+	// Still being parsed
+	if (streaming.import.valid())
+	{
+		if (streaming.import.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+		streaming.imported = streaming.import.get();
+
+		const size_t materialCount = streaming.imported.textureNames.size();
+		streaming.matToTex.assign(materialCount, 0);
+		streaming.uploadedTextures.assign(materialCount, -1);
+		streaming.textureTickets.assign(materialCount, 0);
+	}
+
+	// Textures are uploaded as soon as they're decoded, but only drawn with once the upload has finished
+	bool texturesChanged = false;
+	bool texturesDone = true;
+	for (size_t i = 0; i < streaming.imported.textureNames.size(); ++i)
+	{
+		auto& decodedTexture = streaming.imported.decodedTextures[i];
+		if (decodedTexture.valid())
+		{
+			if (decodedTexture.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				texturesDone = false;
+				continue;
+			}
+
+			// One that can't be decoded isn't worth failing the model over, its meshes keep the default texture
+			DecodedTexture decoded;
+			try
+			{
+				decoded = decodedTexture.get();
+			}
+			catch (const std::exception&)
+			{
+				continue;
+			}
+
+			streaming.uploadedTextures[i] = CreateTexture(streaming.imported.textureNames[i], decoded);
+			modelTextures[streaming.modelIndex].push_back(streaming.uploadedTextures[i]);
+			streaming.textureTickets[i] = uploadQueue.GetRecordingTicket();
+		}
+
+		if (streaming.uploadedTextures[i] < 0 || streaming.matToTex[i] == streaming.uploadedTextures[i]) continue;
+
+		if (!uploadQueue.IsComplete(streaming.textureTickets[i]))
+		{
+			texturesDone = false;
+			continue;
+		}
+
+		streaming.matToTex[i] = streaming.uploadedTextures[i];
+		texturesChanged = true;
+	}
+
+	// Meshes are uploaded together once every one of them has been converted
+	if (!streaming.meshesUploaded)
+	{
+		for (auto& convertedMesh : streaming.imported.convertedMeshes)
+		{
+			if (convertedMesh.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+		}
+
+		UploadImportedMeshes(streaming.imported, streaming.meshes, streaming.meshMaterials,
+		                     &streaming.vertexQuantization);
+
+		streaming.meshTicket = uploadQueue.GetRecordingTicket();
+		streaming.meshesUploaded = true;
+	}
+
+	// and drawn once their geometry is resident
+	bool meshesChanged = false;
+	if (!streaming.meshesPlaced)
+	{
+		if (!uploadQueue.IsComplete(streaming.meshTicket)) return false;
+
+		modelList[streaming.modelIndex].SetMeshList(std::move(streaming.meshes));
+		modelList[streaming.modelIndex].SetVertexQuantization(streaming.vertexQuantization);
+		streaming.meshes.clear();
+		streaming.meshesPlaced = true;
+		meshesChanged = true;
+	}
+
+	if (texturesChanged || meshesChanged)
+	{
+		MeshModel& model = modelList[streaming.modelIndex];
+		for (size_t i = 0; i < model.GetMeshCount(); ++i)
+		{
+			model.GetMesh(i)->SetTexId(streaming.matToTex[streaming.meshMaterials[i]]);
+		}
+
+		BuildIndirectBatches();
+		MarkCommandBuffersDirty();
+	}
+
+	return texturesDone;
+}
+
+void VulkanRenderer::UpdateStreamingModels()
+{
+	for (size_t i = 0; i < streamingModels.size();)
+	{
+		bool finished;
+		try
+		{
+			finished = UpdateStreamingModel(streamingModels[i]);
+		}
+		catch (const std::exception& error)
+		{
+			// A failed load is dropped, and whatever meshes and textures it already handed the model are unloaded
+			// so the model is left empty. It's reported through the model's load state rather than thrown,
+			// so one bad asset doesn't stop the frame being drawn
+			const uint32_t modelIndex = streamingModels[i].modelIndex;
+			modelLoadErrors[modelIndex] = error.what();
+			DiscardStreamingModel(streamingModels[i]);
+			streamingModels.erase(streamingModels.begin() + i);
+			UnloadMeshModel(modelIndex);
+			continue;
+		}
+
+		if (finished)
+		{
+			streamingModels.erase(streamingModels.begin() + i);
 		}
 		else
 		{
-			matToTex[i] = CreateTexture(textureNames[i]);
+			++i;
 		}
 	}
+}
 
-	// Load in all of the meshes
-	const std::vector<Mesh> modelMeshes = MeshModel::LoadNode(mainDevice.physicalDevice, mainDevice.logicalDevice,
-	                                                          graphicsQueue, graphicsCommandPool, scene->mRootNode,
-	                                                          scene, matToTex);
+void VulkanRenderer::DiscardStreamingModel(StreamingModel& streaming)
+{
+	if (streaming.import.valid())
+	{
+		try
+		{
+			streaming.imported = streaming.import.get();
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
 
-	modelList.emplace_back(modelMeshes);
+	DiscardImport(streaming.imported);
 
-	return modelList.size() - 1;
+	// Geometry that was uploaded but never handed to the model
+	for (auto& mesh : streaming.meshes)
+	{
+		mesh.DestroyMeshBuffers();
+	}
+	streaming.meshes.clear();
 }
 
 VkBool32 VulkanRenderer::DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -1965,20 +3932,78 @@ VkBool32 VulkanRenderer::DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT me
 	return VK_FALSE;
 }
 
-stbi_uc* VulkanRenderer::LoadTextureFile(const std::string& fileName, int& width, int& height, VkDeviceSize* imageSize)
+DecodedTexture VulkanRenderer::LoadTextureFile(const std::string& fileName) const
 {
-	int channels;
-
 	const std::string fileLocation = "Textures/" + fileName;
 
-	stbi_uc* image = stbi_load(fileLocation.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	DecodedTexture texture;
+
+	// Files are keyed by where they were loaded from and what's in them, once one is in the cache
+	// nothing more is read from it (a mapped compressed file is dropped again, an image is never decoded)
+	const auto setCompressedKey = [this, &texture](const std::string& location)
+	{
+		texture.key = TextureCache::MakeKey(location, texture.file->GetData(), texture.file->GetSize());
+		if (textureCache.Contains(texture.key))
+		{
+			DecodedTexture cached;
+			cached.key = texture.key;
+			texture = std::move(cached);
+		}
+	};
+
+	// Block compressed files are uploaded as they are, mips and all. Materials name the source image,
+	// so a converted file next to it (same name, .ktx2 or .dds) is used instead when there is one
+	const size_t extensionStart = fileLocation.rfind('.');
+	const std::string extension = extensionStart == std::string::npos ? "" : fileLocation.substr(extensionStart);
+	const std::string stem = fileLocation.substr(0, extensionStart);
+
+	if (extension == ".ktx2" || extension == ".dds")
+	{
+		if (!compressedTexturesSupported || !TextureFile::LoadCompressed(fileLocation, &texture))
+		{
+			throw std::runtime_error("Failed to load Texture file! (" + fileName + ")");
+		}
+		setCompressedKey(fileLocation);
+		return texture;
+	}
+
+	if (compressedTexturesSupported)
+	{
+		for (const std::string& compressedLocation : {stem + ".ktx2", stem + ".dds"})
+		{
+			if (!TextureFile::LoadCompressed(compressedLocation, &texture)) continue;
+
+			setCompressedKey(compressedLocation);
+			return texture;
+		}
+	}
+
+	MappedFile source;
+	if (!source.Open(fileLocation))
+	{
+		throw std::runtime_error("Failed to load Texture file! (" + fileName + ")");
+	}
+
+	texture.key = TextureCache::MakeKey(fileLocation, source.GetData(), source.GetSize());
+	if (textureCache.Contains(texture.key)) return texture;
 
-	if (!image)
+	int channels;
+	texture.pixels = stbi_load_from_memory(source.GetData(), static_cast<int>(source.GetSize()), &texture.width,
+	                                       &texture.height, &channels, STBI_rgb_alpha);
+
+	if (!texture.pixels)
 	{
 		throw std::runtime_error("Failed to load Texture file! (" + fileName + ")");
 	}
 
-	*imageSize = static_cast<VkDeviceSize>(width) * (height) * 4;
+	texture.data = texture.pixels;
+	texture.size = static_cast<VkDeviceSize>(texture.width) * (texture.height) * 4;
 
-	return image;
+	TextureLevel level;
+	level.size = texture.size;
+	level.width = static_cast<uint32_t>(texture.width);
+	level.height = static_cast<uint32_t>(texture.height);
+	texture.levels.push_back(level);
+
+	return texture;
 }
@@ -10,20 +10,79 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <future>
+#include <memory>
 #include <vector>
-#include "stb_image.h"
 #include "Utilities.h"
+#include "FrustumCuller.h"
+#include "DrawList.h"
+#include "MeshCache.h"
 #include "MeshModel.h"
+#include "GpuProfiler.h"
+#include "TextureFile.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "UniformRingBuffer.h"
+#include "UploadQueue.h"
+
+// Scene of an imported model file, with the texture decodes and mesh conversions queued for it
+struct ImportedModel
+{
+	std::vector<std::string> textureNames; // one per material, empty when it has no texture
+	std::vector<std::future<DecodedTexture>> decodedTextures; // one per material, not valid when it has no texture
+	std::vector<std::future<MeshData>> convertedMeshes; // in draw order
+
+	// Set when the meshes come from a cooked file instead, mapped until they've been uploaded
+	std::shared_ptr<MeshCache> meshCache;
+	// Otherwise the converted meshes are cooked under this key once they've been uploaded
+	std::string modelFile;
+	MeshCacheKey cacheKey;
+};
+
+// Model loading in the background. Its meshes are handed to the model once their upload has finished,
+// until then it draws nothing. Its meshes use the default texture until their own texture has been uploaded.
+struct StreamingModel
+{
+	uint32_t modelIndex = 0;
+	std::future<ImportedModel> import; // valid until the import has been picked up
+	ImportedModel imported;
+
+	std::vector<int> matToTex; // texture id drawn with for each material
+	std::vector<int> uploadedTextures; // texture id of each material's own texture, -1 until it's been created
+	std::vector<uint64_t> textureTickets;
+
+	std::vector<Mesh> meshes; // uploaded but not yet given to the model
+	std::vector<uint32_t> meshMaterials;
+	VertexQuantization vertexQuantization;
+	uint64_t meshTicket = 0;
+	bool meshesUploaded = false;
+	bool meshesPlaced = false;
+};
+
+// How far a model loaded with LoadMeshModelAsync has got
+enum class ModelLoadState
+{
+	LOADING,
+	LOADED,
+	FAILED // it stays empty, GetModelLoadError says why
+};
 
 class VulkanRenderer
 {
 private:
 	GLFWwindow* window = nullptr;
 
+	// Headless mode renders into offscreen images instead of a swap chain
+	bool headless = false;
+	uint32_t nextOffscreenImage = 0;
+
 	int currentFrame = 0;
+	uint64_t frameNumber = 0; // total frames submitted
+	uint32_t lastImageIndex = 0; // image the last Draw submitted
 
 	// Scene Objects
 	std::vector<MeshModel> modelList;
+	std::vector<uint32_t> freeModelIds; // slots of unloaded models, reused before the list grows
 	
 	// Scene Settings
 	struct UboViewProjection
@@ -31,6 +90,72 @@ private:
 		glm::mat4 view;
 		glm::mat4 projection;
 	}uboViewProjection;
+
+	// Per object uniform data, allocated from the uniform ring every frame and bound with a dynamic offset
+	struct UboModel
+	{
+		glm::mat4 model;
+	};
+
+	// Indirect drawing: one indirect command per mesh, grouped into batches sharing geometry buffers and texture
+	struct IndirectBatch
+	{
+		uint32_t bufferIndex;
+		int texId;
+		uint32_t firstCommand;
+		uint32_t commandCount;
+	};
+
+	struct MeshDraw
+	{
+		uint32_t modelIndex;
+		uint32_t meshIndex;
+		uint32_t drawIndex; // in the order RecordGeometry numbers draws
+	};
+
+	bool indirectDrawing = false;
+	bool indirectDrawingSupported = false; // needs drawIndirectFirstInstance to pick the model
+	bool multiDrawIndirectSupported = false; // otherwise each batch is one call per command
+	std::vector<MeshDraw> indirectDraws; // meshes in indirect command order
+	std::vector<IndirectBatch> indirectBatches;
+
+	// GPU culling: a compute pass tests each mesh's bounds and packs the visible ones into the indirect commands
+	struct CullDraw
+	{
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t firstObject; // first entry in the model array
+		uint32_t batchFirstCommand;
+		uint32_t batchIndex;
+		uint32_t instanceCount;
+		uint32_t padding; // std430 array stride of 64
+	};
+
+	bool gpuCulling = false; // only used by the indirect path
+	bool gpuCullingSupported = false;
+
+	// CPU culling: every mesh's box is tested before recording, in the order RecordGeometry numbers draws
+	bool cpuCulling = false;
+	FrustumCuller frustumCuller;
+	std::vector<uint8_t> drawVisible;
+
+	// Instancing: models with added instances are drawn once per instance, at model * instance transform
+	std::vector<std::vector<glm::mat4>> modelInstances; // [model][instance], empty when the model is drawn once
+	std::vector<uint32_t> modelFirstInstances; // start of each model's instances in the instance buffer
+	std::vector<uint32_t> modelFirstObjects; // indirect path: start of each model's entries in the model array
+	uint32_t totalInstanceCount = 0;
+
+	// Draws of the direct path in the order they are recorded, sorted by state when sortDraws is set
+	bool sortDraws = false;
+	DrawList drawList;
+	BindStats lastBindStats; // of the last recorded command buffer
+
+	// Command buffer caching (only re-record when the scene changes)
+	bool cacheCommandBuffers = false;
+	std::vector<bool> commandBufferDirty;
 	
 	// Vulkan Components
 	VkInstance instance = nullptr;
@@ -42,54 +167,113 @@ private:
 		VkDevice logicalDevice = nullptr;
 	} mainDevice;
 
+	// All buffer and image memory is sub-allocated from here
+	std::unique_ptr<DeviceMemoryAllocator> memoryAllocator;
+
+	// Vertex and index buffers shared by every mesh
+	std::unique_ptr<GeometryPool> geometryPool;
+
 	VkQueue graphicsQueue = nullptr;
 	VkQueue presentationQueue = nullptr;
+	VkQueue transferQueue = nullptr; // same as the graphics queue when the device has no separate transfer family
 	VkSurfaceKHR surface{};
 	VkSwapchainKHR swapchain{};
 	
 	std::vector<SwapChainImage> swapChainImages;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
+	// Only used in headless mode, where the "swap chain" images are owned by the renderer
+	std::vector<MemoryAllocation> offscreenImageMemory;
+
 	std::vector<VkImage> colorBufferImages;
-	std::vector<VkDeviceMemory> colorBufferImageMemory;
+	std::vector<MemoryAllocation> colorBufferImageMemory;
 	std::vector<VkImageView> colorBufferImageViews;
 
 	std::vector<VkImage> depthBufferImages;
-	std::vector<VkDeviceMemory> depthBufferImageMemory;
+	std::vector<MemoryAllocation> depthBufferImageMemory;
 	std::vector<VkImageView> depthBufferImageViews;
 
 	VkSampler textureSampler;
 	
 	std::vector<VkCommandBuffer> commandBuffers;
 
+	// Decoding and mesh conversion of loaded assets, only the uploads are recorded on the loading thread
+	std::unique_ptr<ThreadPool> loadingThreads;
+	std::vector<StreamingModel> streamingModels; // advanced once per frame
+	std::vector<std::string> modelLoadErrors; // [model] why streaming it in failed, empty unless it did
+
+	// Multi-threaded recording of the geometry subpass, draws are split into one chunk per thread
+	std::unique_ptr<ThreadPool> recordingThreads;
+	std::vector<VkCommandPool> recordingCommandPools; // one per chunk, only ever used by one task at a time
+	std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers; // [image][chunk]
+
 	// Descriptors
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSetLayout samplerSetLayout;
 	VkDescriptorSetLayout inputSetLayout;
-	VkPushConstantRange pushConstantRange;
+	VkDescriptorSetLayout indirectSetLayout;
+	VkDescriptorSetLayout cullSetLayout;
 	
 	VkDescriptorPool descriptorPool;
 	VkDescriptorPool samplerDescriptorPool;
 	VkDescriptorPool inputDescriptorPool;
 	std::vector<VkDescriptorSet> descriptorSets;
-	std::vector<VkDescriptorSet> samplerDescriptorSets;
+	std::vector<VkDescriptorSet> samplerDescriptorSets; // one texture array per image, bound once per command buffer
 	std::vector<VkDescriptorSet> inputDescriptorSets;
+	std::vector<VkDescriptorSet> indirectDescriptorSets;
+	std::vector<VkDescriptorSet> cullDescriptorSets;
+
+	// Textures are picked by index from one array, the texture id is pushed per draw
+	uint32_t textureArraySize = 0;
+	std::vector<std::vector<uint32_t>> textureDescriptorWrites; // [image] slots changed since its array was written
 	
 	std::vector<VkBuffer> vpUniformBuffers;
-	std::vector<VkDeviceMemory> vpUniformBufferMemory;
-	
-	//std::vector<VkBuffer> modelDynamicUniformBuffers;
-	//std::vector<VkDeviceMemory> modelDynamicUniformBufferMemory;
+	std::vector<MemoryAllocation> vpUniformBufferMemory;
+	std::vector<UboViewProjection*> vpUniformBufferMapped; // mapped for the lifetime of the buffer
+
+	// Indirect commands and model matrices of the indirect path (one of each per image, persistently mapped)
+	std::vector<VkBuffer> indirectCommandBuffers;
+	std::vector<MemoryAllocation> indirectCommandBufferMemory;
+	std::vector<VkBuffer> objectBuffers;
+	std::vector<MemoryAllocation> objectBufferMemory;
+
+	// Transforms of every instance, one per image (persistently mapped, bound as a per instance vertex buffer)
+	std::vector<VkBuffer> instanceBuffers;
+	std::vector<MemoryAllocation> instanceBufferMemory;
+
+	// Culling inputs (persistently mapped) and per batch counters of visible draws (GPU only), one per image
+	std::vector<VkBuffer> cullDrawBuffers;
+	std::vector<MemoryAllocation> cullDrawBufferMemory;
+	std::vector<VkBuffer> batchCountBuffers;
+	std::vector<MemoryAllocation> batchCountBufferMemory;
+
+	// Per object data of every model, one region of the ring per image. The offsets point into the region of the image
+	// last passed to UpdateUniformBuffers, so they are only valid while recording that image
+	UniformRingBuffer modelUniformRing;
+	std::vector<uint32_t> modelUniformOffsets; // dynamic offset of each model's data
 
 	// Assets	
-	std::vector<VkImage> textureImages;
-	std::vector<VkDeviceMemory> textureImageMemory;
+	std::vector<VkImage> textureImages; // by texture id, null where a texture has been destroyed
+	std::vector<MemoryAllocation> textureImageMemory;
 	std::vector<VkImageView> textureImageViews;
+	std::vector<int> freeTextureIds; // ids of destroyed textures, reused before the array grows
+	std::vector<std::vector<int>> modelTextures; // [model] texture ids the model holds a reference to
+	TextureCache textureCache;
+	bool compressedTexturesSupported = false; // textureCompressionBC, otherwise block compressed files are skipped
+	bool mipmapGenerationSupported = false; // linear blits of RGBA8 images, otherwise decoded textures keep one level
 	
 	// Pipeline
 	VkPipeline graphicsPipeline{};
 	VkPipelineLayout pipelineLayout{};
 
+	VkPipeline instancePipeline{}; // uses pipelineLayout
+
+	VkPipeline indirectPipeline{};
+	VkPipelineLayout indirectPipelineLayout{};
+
+	VkPipeline cullPipeline{};
+	VkPipelineLayout cullPipelineLayout{};
+
 	VkPipeline secondPipeline{};
 	VkPipelineLayout secondPipelineLayout{};
 	VkRenderPass renderPass{};
@@ -97,6 +281,12 @@ private:
 	// Pools
 	VkCommandPool graphicsCommandPool{};
 
+	// Staged uploads, copied on the transfer queue and handed over to graphics
+	UploadQueue uploadQueue;
+
+	// Profiling
+	GpuProfiler gpuProfiler;
+
 	// Vulkan Utilities
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent{};
@@ -104,12 +294,13 @@ private:
 	VkFormat depthBufferImageFormat;
 
 	VkDeviceSize minUniformBufferOffset;
-	size_t modelUniformAlignment;
 
 	// Synchronization
 	std::vector<VkSemaphore> imageAvailable;
 	std::vector<VkSemaphore> renderFinished;
 	std::vector<VkFence> drawFences;
+	std::vector<VkFence> imagesInFlight; // [image] draw fence of the frame that last used it, null until one has
+	double lastFenceWaitMs = 0.0; // time the last Draw spent blocked on its frame fence
 
 	const std::vector<const char*> validationLayers =
 	{
@@ -129,6 +320,7 @@ private:
 
 public:
 	VulkanRenderer(GLFWwindow* pWindow);
+	explicit VulkanRenderer(const HeadlessSettings& settings);
 	~VulkanRenderer();
 	VulkanRenderer(VulkanRenderer& other) = delete;
 	VulkanRenderer& operator= (const VulkanRenderer& other) = delete;
@@ -138,31 +330,89 @@ public:
 	void Draw();
 	void UpdateModel(uint32_t modelId, glm::mat4 newModel);
 	uint32_t CreateMeshModel(const std::string& modelFile);
+	uint32_t LoadMeshModelAsync(const std::string& modelFile); // model is empty until it has streamed in
+	bool IsModelLoaded(uint32_t modelId) const; // false while it streams in, and when that failed
+	ModelLoadState GetModelLoadState(uint32_t modelId) const;
+	std::string GetModelLoadError(uint32_t modelId) const; // empty unless its load failed
+	// The model's id may be reused by a later load, textures go once no other model uses them
+	void UnloadMeshModel(uint32_t modelId);
+	uint32_t AddModelInstance(uint32_t modelId, glm::mat4 transform);
+	void UpdateModelInstance(uint32_t modelId, uint32_t instanceId, glm::mat4 transform);
+	uint32_t GetModelInstanceCount(uint32_t modelId) const;
+
+	bool IsHeadless() const;
+	VkExtent2D GetExtent() const;
+	double GetLastFenceWaitMs() const;
+	GpuTimings GetGpuTimings() const;
+	MemoryStats GetMemoryStats() const;
+	void SetGpuProfilerLogInterval(uint32_t frames);
+	void SetCommandBufferCaching(bool enabled);
+	void SetRecordingThreadCount(uint32_t threadCount);
+	void SetIndirectDrawing(bool enabled);
+	bool IsIndirectDrawingSupported() const;
+	bool IsTransferQueueDedicated() const;
+	void WaitForUploads(); // submit recorded uploads and block until they have finished
+	void SetGpuCulling(bool enabled);
+	bool IsGpuCullingSupported() const;
+	void SetCpuCulling(bool enabled);
+	void SetDrawSorting(bool enabled);
+	BindStats GetBindStats() const;
+	CullStats GetCullStats() const;
+	// Waits for the device, then compares the draws the last frame's cull pass kept with CPU culling of the same
+	// boxes (which adds to the cull stats). False with the first difference in mismatch when they don't agree
+	bool CheckGpuCulling(std::string* mismatch);
 
 private:
+	void InitRenderer();
+
 	// Vulkan Functions
 	// - Create Functions
 	void CreateInstance();
 	void CreateLogicalDevice();
+	void CreateMemoryAllocator();
 	void CreateSurface();
 	void CreateSwapChain();
+	void CreateOffscreenImages(uint32_t imageCount);
 	void CreateRenderPass();
 	void CreateDescriptorSetLayout();
-	void CreatePushConstantRange();
 	void CreateGraphicsPipeline();
+	void CreateCullPipeline();
 	void CreateColorBufferImage();
 	void CreateDepthBufferImage();
 	void CreateFrameBuffers();
 	void CreateCommandPool();
 	void CreateCommandBuffers();
 	void CreateUniformBuffers();
+	void CreateIndirectBuffers();
 	void CreateDescriptorPools();
 	void CreateDescriptorSets();
 	void CreateInputDescriptorSets();
+	void CreateTextureDescriptorSets();
+	void CreateIndirectDescriptorSets();
+	void CreateCullDescriptorSets();
 	void CreateSynchronization();
 	void CreateTextureSampler();
+	void CreateGpuProfiler();
+	void CreateGeometryPool();
+	void CreateUploadQueue();
+	void CreateLoadingThreads();
+	void CreateRecordingThreads(uint32_t threadCount);
+	void DestroyRecordingThreads();
 
 	void RecordCommands(uint32_t currentImage);
+	void RecordSecondaryCommands(uint32_t currentImage);
+	void RecordGeometry(VkCommandBuffer commandBuffer, uint32_t currentImage, size_t firstDraw, size_t endDraw,
+	                    BindStats& bindStats);
+	void RecordIndirectGeometry(VkCommandBuffer commandBuffer, uint32_t currentImage, BindStats& bindStats);
+	void RecordCulling(VkCommandBuffer commandBuffer, uint32_t currentImage);
+	size_t GetDrawCount() const;
+	void BuildDrawList();
+	void CullDraws();
+	void BuildIndirectBatches();
+	void UpdateIndirectCommands(uint32_t imageIndex);
+	void UpdateInstanceBuffer(uint32_t imageIndex);
+	uint32_t GetDrawInstanceCount(size_t modelIndex) const;
+	void MarkCommandBuffersDirty();
 
 	void UpdateUniformBuffers(uint32_t imageIndex);
 	
@@ -192,7 +442,7 @@ private:
 
 	// - - Getter Functions
 	QueueFamilyIndices GetQueueFamilies(VkPhysicalDevice device) const;
-	std::vector<const char*> GetRequiredGLFWExtensions() const;
+	std::vector<const char*> GetRequiredInstanceExtensions() const;
 	SwapChainDetails GetSwapChainDetails(VkPhysicalDevice device) const;
 
 	// - - Chooser Functions
@@ -202,14 +452,28 @@ private:
 	VkFormat ChooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags) const;
 
 	// - - Create Functions
-	VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory) const;
-	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) const;
+	VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags, MemoryAllocation* imageMemory, uint32_t mipLevels = 1);
+	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1) const;
 	VkShaderModule CreateShaderModule(const std::vector<char>& shaderCode) const;
 
-	int CreateTextureImage(const std::string& fileName);
+	uint32_t CreateModelSlot(const std::string& modelFile); // empty model, in an unloaded model's slot if there is one
+	ImportedModel ImportModel(const std::string& modelFile) const; // safe to call from a loading thread
+	static void DiscardImport(ImportedModel& imported);
+	// Every mesh has to have been converted already, they're all given the default texture
+	void UploadImportedMeshes(ImportedModel& imported, std::vector<Mesh>& meshes,
+	                          std::vector<uint32_t>& meshMaterials, VertexQuantization* vertexQuantization);
+	bool UpdateStreamingModel(StreamingModel& streaming);
+	void UpdateStreamingModels();
+	void DiscardStreamingModel(StreamingModel& streaming);
+
+	VkImage CreateTextureImage(const DecodedTexture& texture, MemoryAllocation* imageMemory);
 	int CreateTexture(const std::string& fileName);
-	int CreateTextureDescriptor(VkImageView textureImage);
+	// Frees the decoded pixels. A texture the cache already has is shared, every call holds one reference
+	int CreateTexture(const std::string& fileName, const DecodedTexture& texture);
+	void ReleaseTexture(int textureId); // destroyed with its last reference
+	void DestroyTexture(int textureId);
+	void UpdateTextureDescriptors(uint32_t imageIndex);
 	
 	// - - Loader Functions
-	stbi_uc* LoadTextureFile(const std::string& fileName, int& width, int& height, VkDeviceSize* imageSize);
+	DecodedTexture LoadTextureFile(const std::string& fileName) const; // safe to call from any thread
 };